@@ -0,0 +1,117 @@
+#include "base_versions.h"
+#include <algorithm>
+#include <limits>
+#include <thread>
+#include <utility>
+
+namespace server
+{
+    VersionedBase::Reader::Reader(const VersionedBase& base, std::atomic<uint64_t>* slot, const BaseVersion* version)
+        : base_(&base)
+        , slot_(slot)
+        , version_(version)
+    {}
+
+    VersionedBase::Reader::Reader(Reader&& other) noexcept
+        : base_(other.base_)
+        , slot_(std::exchange(other.slot_, nullptr))
+        , version_(other.version_)
+    {}
+
+    VersionedBase::Reader::~Reader()
+    {
+        if (slot_)
+        {
+            slot_->store(0);
+
+            // Последний читатель заменённой версии удаляет её сам, не дожидаясь следующего обновления
+            if (base_->has_retired_.load())
+            {
+                base_->TryReclaim();
+            }
+        }
+    }
+
+    VersionedBase::VersionedBase(std::unique_ptr<BaseVersion> first, VersionBuilder build)
+        : build_(std::move(build))
+        , current_(first.get())
+        , published_(std::move(first))
+    {}
+
+    // Читателей к моменту удаления быть не должно
+    VersionedBase::~VersionedBase() = default;
+
+    VersionedBase::Reader VersionedBase::Read() const
+    {
+        for (;;)
+        {
+            for (ReaderSlot& reader_slot : reader_slots_)
+            {
+                std::atomic<uint64_t>& slot = reader_slot.epoch;
+                uint64_t free = 0;
+
+                if (slot.load(std::memory_order_relaxed) == 0 && slot.compare_exchange_strong(free, epoch_.load()))
+                {
+                    /*
+                    * Версия читается после записи эпохи. Если писатель заменил её раньше, чем эпоха стала видна,
+                    * то он сначала опубликовал новую версию, и здесь будет прочитана уже она
+                    */
+                    return Reader(*this, &slot, current_.load());
+                }
+            }
+
+            std::this_thread::yield();
+        }
+    }
+
+    uint64_t VersionedBase::Update(const json::Array& base_requests)
+    {
+        std::lock_guard guard(writer_mutex_);
+
+        auto next = std::make_unique<BaseVersion>();
+        next->number = published_->number + 1;
+        next->catalogue = json_reader::UpdateCatalogue(*published_->catalogue, base_requests);
+        build_(*published_, *next);
+
+        const uint64_t number = next->number;
+
+        current_.store(next.get());
+        retired_.push_back({ std::exchange(published_, std::move(next)), epoch_.fetch_add(1) });
+
+        Reclaim();
+
+        return number;
+    }
+
+    void VersionedBase::TryReclaim() const
+    {
+        std::unique_lock guard(writer_mutex_, std::try_to_lock);
+
+        if (guard.owns_lock())
+        {
+            Reclaim();
+        }
+    }
+
+    void VersionedBase::Reclaim() const
+    {
+        uint64_t oldest_reader = std::numeric_limits<uint64_t>::max();
+
+        for (const ReaderSlot& slot : reader_slots_)
+        {
+            const uint64_t epoch = slot.epoch.load();
+
+            if (epoch != 0)
+            {
+                oldest_reader = std::min(oldest_reader, epoch);
+            }
+        }
+
+        retired_.erase(std::remove_if(retired_.begin(), retired_.end(), [oldest_reader](const Retired& retired)
+        {
+            return retired.epoch < oldest_reader;
+        }), retired_.end());
+
+        has_retired_.store(!retired_.empty());
+    }
+} // end namespace server
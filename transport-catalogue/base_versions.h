@@ -0,0 +1,123 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "json.h"
+#include "json_reader.h"
+#include "request_handler.h"
+#include "response_cache.h"
+#include "transport_catalogue.h"
+
+/*
+* Версии базы для сервера, принимающего изменения на ходу (RCU).
+* Опубликованная версия не меняется: обновление строит новый справочник по копии текущего, готовит для него
+* обработчик запросов и публикует одной атомарной записью указателя. Запрос, начатый до публикации,
+* дочитывает свою версию, а следующие запросы видят новую.
+* Читатели не берут блокировок: версия закрепляется записью эпохи в свободную ячейку атомарного массива.
+* Заменённая версия удаляется, как только не остаётся читателей, закрепившихся до её замены: это проверяет
+* следующее обновление или читатель, освобождающий ячейку. Поэтому после обновления в памяти держатся не больше
+* двух версий и тех заменённых, что ещё читаются
+*/
+namespace server
+{
+    struct BaseVersion
+    {
+        uint64_t number = 1;
+        std::shared_ptr<tc::TransportCatalogue> catalogue;
+        std::shared_ptr<RequestHandler> request_handler;
+        // Ссылается на справочник и обработчик, поэтому объявлен последним и удаляется первым
+        std::unique_ptr<json_reader::ResponseCache> response_cache;
+    };
+
+    class VersionedBase
+    {
+        public:
+
+            // Дополняет версию с заполненным справочником обработчиком запросов и кэшем ответов; previous — заменяемая версия
+            using VersionBuilder = std::function<void(const BaseVersion& previous, BaseVersion& version)>;
+
+            // Закреплённая версия; пока объект жив, версия не удаляется
+            class Reader
+            {
+                public:
+
+                    Reader(Reader&& other) noexcept;
+                    Reader& operator=(Reader&&) = delete;
+                    ~Reader();
+
+                    const BaseVersion& operator*() const
+                    {
+                        return *version_;
+                    }
+
+                    const BaseVersion* operator->() const
+                    {
+                        return version_;
+                    }
+
+                private:
+
+                    friend class VersionedBase;
+
+                    Reader(const VersionedBase& base, std::atomic<uint64_t>* slot, const BaseVersion* version);
+
+                    const VersionedBase* base_;
+                    std::atomic<uint64_t>* slot_;
+                    const BaseVersion* version_;
+            };
+
+            VersionedBase(std::unique_ptr<BaseVersion> first, VersionBuilder build);
+            ~VersionedBase();
+
+            VersionedBase(const VersionedBase&) = delete;
+            VersionedBase& operator=(const VersionedBase&) = delete;
+
+            // Закрепляет текущую версию. Без блокировок; ждёт, только если заняты все ячейки читателей
+            Reader Read() const;
+            /*
+            * Применяет base_requests к копии текущей версии и публикует результат; возвращает номер новой версии.
+            * Обновления выполняются по одному. Бросает std::logic_error при ссылке на неизвестную остановку
+            */
+            uint64_t Update(const json::Array& base_requests);
+
+        private:
+
+            struct Retired
+            {
+                std::unique_ptr<BaseVersion> version;
+                // Эпоха, в которую версию заменили: её могут читать только читатели с эпохой не новее этой
+                uint64_t epoch;
+            };
+
+            // Ячейка читателя занимает свою строку кэша: запись в неё не сбрасывает строки соседних читателей
+            struct alignas(64) ReaderSlot
+            {
+                // Эпоха, в которую читатель закрепил версию; 0 — ячейка свободна
+                std::atomic<uint64_t> epoch{ 0 };
+            };
+
+            // Удаляет заменённые версии, которые больше никто не читает. Вызывается под writer_mutex_
+            void Reclaim() const;
+            // Вызывается освободившим ячейку читателем; не ждёт, если мьютекс занят обновлением, которое само вызовет Reclaim
+            void TryReclaim() const;
+
+            static constexpr size_t READER_SLOTS = 256;
+
+            VersionBuilder build_;
+            std::atomic<const BaseVersion*> current_;
+            std::atomic<uint64_t> epoch_{ 1 };
+            mutable std::array<ReaderSlot, READER_SLOTS> reader_slots_{};
+
+            // Заменённые версии меняются и писателем, и освобождающими ячейки читателями, поэтому защищены writer_mutex_
+            mutable std::mutex writer_mutex_;
+            std::unique_ptr<BaseVersion> published_;
+            mutable std::vector<Retired> retired_;
+            mutable std::atomic<bool> has_retired_{ false };
+    };
+} // end namespace server
@@ -1,5 +1,11 @@
 #include "json.h"
+#include "json_writer.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cctype>
+#include <istream>
 #include <iterator>
+#include <streambuf>
 
 using namespace std::literals;
 
@@ -7,8 +13,6 @@ namespace json
 {
     namespace 
     {
-        Node LoadNode(std::istream& input);
-
         std::string LoadLiteral(std::istream& input) 
         {
             std::string str;
@@ -280,50 +284,385 @@ namespace json
 
             return Node(std::move(dict));
         }
+    }  // end namespace
+
+    Node LoadNode(std::istream& input) 
+    {
+        char c;
+
+        if (!(input >> c)) 
+        {
+            throw ParsingError("Unexpected EOF"s);
+        }
 
-        Node LoadNode(std::istream& input) 
+        switch (c) 
         {
-            char c;
+            case '[':
+                return LoadArray(input);
+
+            case '{':
+                return LoadDict(input);
+
+            case '"':
+                return LoadString(input);
+
+            case 't':
+                // Атрибут [[fallthrough]] (провалиться) ничего не делает, и является
+                // подсказкой компилятору и человеку, что здесь программист явно задумывал
+                // разрешить переход к инструкции следующей ветки case, а не случайно забыл
+                // написать break, return или throw.
+                // В данном случае, встретив t или f, переходим к попытке парсинга
+                // литералов true либо false
+                [[fallthrough]];
+            case 'f':
+                input.putback(c);
+                return LoadBool(input);
+
+            case 'n':
+                input.putback(c);
+                return LoadNull(input);
+
+            default:
+                input.putback(c);
+                return LoadNumber(input);
+        }
+    }
+
+    void LoadDictItems(std::istream& input, const std::function<void(const std::string& key, std::istream& input)>& on_item) 
+    {
+        char c;
+
+        if (!(input >> c) || c != '{') 
+        {
+            throw ParsingError("Dictionary is expected"s);
+        }
+
+        for (; input >> c && c != '}';) 
+        {
+            if (c == '"') 
+            {
+                const std::string key = LoadString(input).AsString();
+
+                if (input >> c && c == ':') 
+                {
+                    // Обработчик сам дочитывает значение, соответствующее ключу
+                    on_item(key, input);
+                } 
+                
+                else 
+                {
+                    throw ParsingError(": is expected but '"s + c + "' has been found"s);
+                }
+            } 
+            
+            else if (c != ',') 
+            {
+                throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
+            }
+        }
+
+        if (!input) 
+        {
+            throw ParsingError("Dictionary parsing error"s);
+        }
+    }
+
+    void LoadArrayItems(std::istream& input, const std::function<void(Node item)>& on_item) 
+    {
+        char c;
 
-            if (!(input >> c)) 
+        if (!(input >> c) || c != '[') 
+        {
+            throw ParsingError("Array is expected"s);
+        }
+
+        for (; input >> c && c != ']';) 
+        {
+            if (c != ',') 
             {
-                throw ParsingError("Unexpected EOF"s);
+                input.putback(c);
             }
 
-            switch (c) 
+            on_item(LoadNode(input));
+        }
+
+        if (!input) 
+        {
+            throw ParsingError("Array parsing error"s);
+        }
+    }
+
+    namespace 
+    {
+        bool IsSpace(char c) 
+        {
+            return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+        }
+
+        // Возвращает позицию после закрывающей кавычки строки, pos указывает на символ после открывающей
+        size_t SkipString(std::string_view text, size_t pos) 
+        {
+            while (pos < text.size()) 
             {
-                case '[':
-                    return LoadArray(input);
+                const char c = text[pos];
 
-                case '{':
-                    return LoadDict(input);
+                if (c == '"') 
+                {
+                    return pos + 1;
+                }
 
-                case '"':
-                    return LoadString(input);
+                // Экранированный символ пропускается вместе с обратной косой чертой
+                pos += c == '\\' ? 2 : 1;
+            }
 
-                case 't':
-                    // Атрибут [[fallthrough]] (провалиться) ничего не делает, и является
-                    // подсказкой компилятору и человеку, что здесь программист явно задумывал
-                    // разрешить переход к инструкции следующей ветки case, а не случайно забыл
-                    // написать break, return или throw.
-                    // В данном случае, встретив t или f, переходим к попытке парсинга
-                    // литералов true либо false
-                    [[fallthrough]];
-                case 'f':
-                    input.putback(c);
-                    return LoadBool(input);
+            throw ParsingError("String parsing error"s);
+        }
 
-                case 'n':
-                    input.putback(c);
-                    return LoadNull(input);
+        std::string_view Trim(std::string_view text) 
+        {
+            while (!text.empty() && IsSpace(text.front())) 
+            {
+                text.remove_prefix(1);
+            }
 
-                default:
-                    input.putback(c);
-                    return LoadNumber(input);
+            while (!text.empty() && IsSpace(text.back())) 
+            {
+                text.remove_suffix(1);
             }
-        }  
+
+            return text;
+        }
+
+        // Поток чтения из буфера в памяти без копирования: элементы, найденные структурным просмотром, разбираются тем же LoadNode, что и поток
+        class ViewBuffer : public std::streambuf 
+        {
+            public:
+
+                explicit ViewBuffer(std::string_view text) 
+                {
+                    Reset(text);
+                }
+
+                void Reset(std::string_view text) 
+                {
+                    // Буфер только читается: putback лишь сдвигает позицию назад, не записывая символ
+                    char* begin = const_cast<char*>(text.data());
+                    setg(begin, begin, begin + text.size());
+                }
+        };
+
+        // Читает из input ровно одно JSON-значение, за которым могут идти только пробельные символы
+        Node LoadWholeNode(std::istream& input) 
+        {
+            Node result = LoadNode(input);
+            char c;
+
+            if (input >> c) 
+            {
+                throw ParsingError("Unexpected characters after JSON value"s);
+            }
+
+            return result;
+        }
     }  // end namespace
 
+    Node LoadNode(std::string_view text) 
+    {
+        ViewBuffer buffer(text);
+        std::istream input(&buffer);
+
+        return LoadWholeNode(input);
+    }
+
+    std::vector<std::string_view> SplitArrayItems(std::string_view array) 
+    {
+        array = Trim(array);
+
+        if (array.empty() || array.front() != '[') 
+        {
+            throw ParsingError("Array is expected"s);
+        }
+
+        std::vector<std::string_view> items;
+        size_t depth = 0;
+        size_t item_begin = 1;
+
+        for (size_t pos = 1; pos < array.size();) 
+        {
+            const char c = array[pos];
+
+            if (c == '"') 
+            {
+                pos = SkipString(array, pos + 1);
+                continue;
+            }
+
+            if (c == '[' || c == '{') 
+            {
+                ++depth;
+            }
+
+            else if ((c == ']' || c == '}') && depth > 0) 
+            {
+                --depth;
+            }
+
+            else if (c == ']' || (c == ',' && depth == 0)) 
+            {
+                const std::string_view item = Trim(array.substr(item_begin, pos - item_begin));
+
+                // Пустой элемент допустим только в пустом массиве
+                if (!item.empty() || c == ',' || !items.empty()) 
+                {
+                    items.push_back(item);
+                }
+
+                if (c == ']') 
+                {
+                    return items;
+                }
+
+                item_begin = pos + 1;
+            }
+
+            ++pos;
+        }
+
+        throw ParsingError("Array parsing error"s);
+    }
+
+    std::vector<std::pair<std::string, std::string_view>> SplitDictItems(std::string_view dict) 
+    {
+        dict = Trim(dict);
+
+        if (dict.empty() || dict.front() != '{') 
+        {
+            throw ParsingError("Dictionary is expected"s);
+        }
+
+        std::vector<std::pair<std::string, std::string_view>> items;
+        size_t pos = 1;
+
+        while (true) 
+        {
+            while (pos < dict.size() && IsSpace(dict[pos])) 
+            {
+                ++pos;
+            }
+
+            if (pos < dict.size() && dict[pos] == '}' && items.empty()) 
+            {
+                return items;
+            }
+
+            if (pos == dict.size() || dict[pos] != '"') 
+            {
+                throw ParsingError("Dictionary parsing error"s);
+            }
+
+            // Ключ разбирается полностью, с учётом экранирования
+            const size_t key_end = SkipString(dict, pos + 1);
+            std::string key = LoadNode(dict.substr(pos, key_end - pos)).AsString();
+            pos = key_end;
+
+            while (pos < dict.size() && IsSpace(dict[pos])) 
+            {
+                ++pos;
+            }
+
+            if (pos == dict.size() || dict[pos] != ':') 
+            {
+                throw ParsingError("Dictionary parsing error"s);
+            }
+
+            // Значение заканчивается на запятой или закрывающей скобке верхнего уровня
+            const size_t value_begin = ++pos;
+            size_t depth = 0;
+
+            for (; pos < dict.size(); ++pos) 
+            {
+                const char c = dict[pos];
+
+                if (c == '"') 
+                {
+                    pos = SkipString(dict, pos + 1) - 1;
+                }
+
+                else if (c == '[' || c == '{') 
+                {
+                    ++depth;
+                }
+
+                else if ((c == ']' || c == '}') && depth > 0) 
+                {
+                    --depth;
+                }
+
+                else if (depth == 0 && (c == ',' || c == '}')) 
+                {
+                    break;
+                }
+            }
+
+            if (pos == dict.size()) 
+            {
+                throw ParsingError("Dictionary parsing error"s);
+            }
+
+            items.emplace_back(std::move(key), Trim(dict.substr(value_begin, pos - value_begin)));
+
+            if (dict[pos++] == '}') 
+            {
+                return items;
+            }
+        }
+    }
+
+    void LoadArrayItemsParallel(std::string_view array, size_t thread_count, const std::function<void(Node item)>& on_item) 
+    {
+        const std::vector<std::string_view> items = SplitArrayItems(array);
+        thread_count = std::max<size_t>(thread_count, 1);
+        // Частей больше, чем потоков: так нагрузка выравнивается при разной длине элементов
+        const size_t chunk_count = std::min(items.size(), thread_count * 4);
+
+        if (chunk_count == 0) 
+        {
+            return;
+        }
+
+        const size_t chunk_size = (items.size() + chunk_count - 1) / chunk_count;
+
+        auto parse_chunk = [&items, chunk_size](size_t chunk) 
+        {
+            Array nodes;
+            const size_t begin = chunk * chunk_size;
+            const size_t end = std::min(items.size(), begin + chunk_size);
+            nodes.reserve(end - begin);
+
+            // Один поток на часть: буфер лишь перенаправляется на очередной элемент
+            ViewBuffer buffer(std::string_view{});
+            std::istream input(&buffer);
+
+            for (size_t i = begin; i < end; ++i) 
+            {
+                buffer.Reset(items[i]);
+                input.clear();
+                nodes.push_back(LoadWholeNode(input));
+            }
+
+            return nodes;
+        };
+
+        // Одновременно разбирается не больше thread_count частей; готовые части передаются в on_item по порядку
+        parallel::RunOrdered((items.size() + chunk_size - 1) / chunk_size, thread_count, parse_chunk, [&on_item](Array nodes) 
+        {
+            for (Node& node : nodes) 
+            {
+                on_item(std::move(node));
+            }
+        });
+    }
+
 /*
     Node::Node(Array array) 
         :
@@ -463,162 +802,15 @@ namespace json
         return Document{LoadNode(input)};
     }
 
-    // Контекст вывода, хранит ссылку на поток вывода и текущий отсуп
-    struct PrintContext 
-    {
-        std::ostream& out;
-        int indent_step = 4;
-        int indent = 0;
-
-        void PrintIndent() const 
-        {
-            for (int i = 0; i < indent; ++i) 
-            {
-                out.put(' ');
-            }
-        }
-        // Возвращает новый контекст вывода с увеличенным смещением
-        PrintContext Indented() const 
-        {
-            return {out, indent_step, indent_step + indent};
-        }
-    };
-
-    void PrintNode(const Node& value, const PrintContext& ctx);
-
-    template <typename Value>
-    void PrintValue(const Value& value, const PrintContext& ctx) 
-    {
-        ctx.out << value;
-    }
-
-    void PrintString(const std::string& value, std::ostream& out) 
-    {
-        out.put('"');
-
-        for (const char current_char : value) 
-        {
-            switch (current_char) 
-            {
-                case '\r':
-                    out << "\\r"sv;
-                    break;
-                case '\n':
-                    out << "\\n"sv;
-                    break;
-                case '\t':
-                    out << "\\t"sv;
-                    break;
-                case '"':
-                    out << "\\";
-                    out << "\"";
-                    break;
-                case '\\':
-                    out << "\\";
-                    break;
-                default:
-                    out.put(current_char);
-                break;
-            }
-        }
-        out.put('"');
-    }
-
-    // В специализации шаблона PrintValue для типа bool параметр value передаётся
-    // по константной ссылке, как и в основном шаблоне.
-    // В качестве альтернативы можно использовать перегрузку:
-    // void PrintValue(bool value, const PrintContext& ctx);
-    template <>
-    void PrintValue<std::string>(const std::string& value, const PrintContext& ctx) 
-    {
-        PrintString(value, ctx.out);
-    }
-
-    template <>
-    void PrintValue<std::nullptr_t>(const std::nullptr_t&, const PrintContext& ctx) 
-    {
-        ctx.out << "null"sv;
-    }
-
-    template <>
-    void PrintValue<bool>(const bool& value, const PrintContext& ctx) 
-    {
-        ctx.out << (value ? "true"sv : "false"sv);
-    }
-
-    template <>
-    void PrintValue<Array>(const Array& nodes, const PrintContext& ctx) 
-    {
-        std::ostream& out = ctx.out;
-        out << "[\n"sv;
-        bool first = true;
-        auto inner_ctx = ctx.Indented();
-
-        for (const Node& node : nodes) 
-        {
-            if (first) 
-            {
-                first = false;
-            } 
-            
-            else 
-            {
-                out << ",\n"sv;
-            }
-
-            inner_ctx.PrintIndent();
-            PrintNode(node, inner_ctx);
-        }
-
-        out.put('\n');
-        ctx.PrintIndent();
-        out.put(']');
-    }
-
-    template <>
-    void PrintValue<Dict>(const Dict& nodes, const PrintContext& ctx) 
-    {
-        std::ostream& out = ctx.out;
-        out << "{\n"sv;
-        bool first = true;
-        auto inner_ctx = ctx.Indented();
-
-        for (const auto& [key, node] : nodes) 
-        {
-            if (first) 
-            {
-                first = false;
-            } 
-            
-            else 
-            {
-                out << ",\n"sv;
-            }
-
-            inner_ctx.PrintIndent();
-            PrintValue(key, ctx);
-            ctx.out << ": "sv;
-            PrintNode(node, inner_ctx);
-        }
-
-        out.put('\n');
-        ctx.PrintIndent();
-        out.put('}');
-    }
-
-    void PrintNode(const Node& node, const PrintContext& ctx) 
+    void Print(const Document& doc, std::ostream& output) 
     {
-        std::visit(
-            [&ctx](const auto& value) 
-            {
-                PrintValue(value, ctx);
-            },
-            node.GetValue());
+        Print(doc, output, PrintSettings{});
     }
 
-    void Print(const Document& doc, std::ostream& output) 
+    void Print(const Document& doc, std::ostream& output, const PrintSettings& settings) 
     {
-        PrintNode(doc.GetRoot(), PrintContext{output});
+        // Документ целиком собирается в буфере Writer и выводится крупными блоками
+        Writer writer(output, settings, Writer::LARGE_FLUSH_THRESHOLD);
+        writer.Value(doc.GetRoot());
     }
-
 }  // namespace json
\ No newline at end of file
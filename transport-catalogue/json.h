@@ -1,8 +1,10 @@
 #pragma once
 
+#include <functional>
 #include <iostream>
 #include <map>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
@@ -120,6 +122,33 @@ class Node final : private std::variant<std::nullptr_t, Array, Dict, bool, int,
     };
 
     Document Load(std::istream& input);
+    // Читает из input одно JSON-значение
+    Node LoadNode(std::istream& input);
+
+    // Потоковое чтение словаря: для каждого ключа вызывается on_item, который должен сам прочитать значение из input.
+    // Позволяет обрабатывать разделы документа, не сохраняя в памяти весь документ целиком
+    void LoadDictItems(std::istream& input, const std::function<void(const std::string& key, std::istream& input)>& on_item);
+    // Потоковое чтение массива: каждый элемент разбирается отдельно и сразу передаётся в on_item
+    void LoadArrayItems(std::istream& input, const std::function<void(Node item)>& on_item);
+
+    // Разбор из буфера в памяти: text должен содержать ровно одно JSON-значение
+    Node LoadNode(std::string_view text);
+    // Быстрый структурный просмотр без разбора значений: находит границы элементов массива
+    // с учётом вложенности скобок и строк
+    std::vector<std::string_view> SplitArrayItems(std::string_view array);
+    // Находит ключи словаря и границы соответствующих им значений
+    std::vector<std::pair<std::string, std::string_view>> SplitDictItems(std::string_view dict);
+    // Разбирает элементы массива частями на нескольких потоках. 
+    // on_item вызывается в вызывающем потоке в исходном порядке элементов
+    void LoadArrayItemsParallel(std::string_view array, size_t thread_count, const std::function<void(Node item)>& on_item);
+
+    // Настройки вывода JSON
+    struct PrintSettings 
+    {
+        // Вывод в одну строку, без переводов строк и отступов
+        bool compact = false;
+    };
 
     void Print(const Document& doc, std::ostream& output);
+    void Print(const Document& doc, std::ostream& output, const PrintSettings& settings);
 }  // end namespace json
\ No newline at end of file
@@ -1,143 +1,481 @@
 #include "json_reader.h"
-#include "json_builder.h"
+#include "json_writer.h"
+#include "parallel.h"
+#include <algorithm>
 #include <optional>
+#include <stdexcept>
+#include <unordered_map>
 
 namespace json_reader 
 {
     using namespace std::literals;
 
-    CommandDescription JsonReader::ParseCommandDescription(const json::Node& request) 
+    void CatalogueLoader::Apply(const json::Node& request) 
     {
-        // description: маршрут или координаты
-        json::Dict description;
+        const json::Dict& description = request.AsDict();
+        // type: автобус или остановка 
+        const std::string& type = description.at("type"s).AsString();
 
-        for (const auto& item : request.AsDict()) 
+        if (type == "Stop"s) 
         {
-            if (item.first != "type"s && item.first != "name"s) 
-            {
-                description.insert(item);
-            }
+            ApplyStop(description);
         }
 
-        return {request.AsDict().at("type"s).AsString(), // Название команды (Stop или Bus)
-                request.AsDict().at("name"s).AsString(),     // Номер маршрута или название остановки
-                description };                        // Параметры маршрута или кординаты
+        else if (type == "Bus"s) 
+        {
+            ApplyBus(description);
+        }
     }
 
-    void JsonReader::ParseRequest(const json::Node& request) 
+    void CatalogueLoader::ApplyStop(const json::Dict& request) 
     {
-        json_reader::CommandDescription command_description = ParseCommandDescription(request);
-        
-        commands_.push_back(std::move(command_description));
+        const std::string& name = request.at("name"s).AsString();
+        catalogue_.AddStop({ name, { request.at("latitude"s).AsDouble(), request.at("longitude"s).AsDouble() }, {} });
+
+        if (!request.count("road_distances"s)) 
+        {
+            return;
+        }
+
+        const tc::Stop* from = catalogue_.GetStop(name);
+
+        for (const auto& [stop_name, distance] : request.at("road_distances"s).AsDict()) 
+        {
+            if (const tc::Stop* to = catalogue_.GetStop(stop_name)) 
+            {
+                catalogue_.SetDistance(from, to, distance.AsInt());
+            }
+
+            else 
+            {
+                // Остановка назначения описана дальше по документу
+                pending_distances_.push_back({ name, stop_name, distance.AsInt() });
+            }
+        }
     }
 
-    std::vector<const tc::Stop*> JsonReader::ParseRoute(const json::Dict& description, tc::TransportCatalogue& catalogue) 
+    void CatalogueLoader::ApplyBus(const json::Dict& request) 
     {
-        std::vector<const tc::Stop*> stop_ptr;
-        
-        for (const auto &stop : description.at("stops"s).AsArray()) 
+        const json::Array& stops = request.at("stops"s).AsArray();
+        std::vector<std::string_view> stop_names;
+        bool resolved = true;
+        stop_names.reserve(stops.size());
+
+        for (const auto& stop : stops) 
         {
-            stop_ptr.push_back(catalogue.GetStop(stop.AsString()));
+            stop_names.push_back(stop.AsString());
+            resolved = resolved && catalogue_.GetStop(stop_names.back());
+        }
+
+        if (resolved) 
+        {
+            AddBus(request.at("name"s).AsString(), stop_names, request.at("is_roundtrip"s).AsBool());
+        }
+
+        else 
+        {
+            // Маршрут ссылается на остановки, описанные дальше по документу
+            pending_buses_.push_back({ request.at("name"s).AsString(), { stop_names.begin(), stop_names.end() }, request.at("is_roundtrip"s).AsBool() });
         }
-        
-        return stop_ptr;
     }
 
-    tc::Stop JsonReader::MakeStop(const json_reader::CommandDescription& command) const
+    void CatalogueLoader::AddBus(std::string number, const std::vector<std::string_view>& stops, bool is_roundtrip) 
     {
-        // id: номер автобуса или название остановки
-        // description: маршрут или координаты
-        tc::Stop stop = {command.id, { command.description.at("latitude"s).AsDouble(), command.description.at("longitude"s).AsDouble()}, {} };
-     
-        return stop;
+        std::vector<const tc::Stop*> stop_ptr;
+        stop_ptr.reserve(stops.size());
+
+        for (const auto stop : stops) 
+        {
+            stop_ptr.push_back(catalogue_.GetStop(stop));
+        }
+
+        catalogue_.AddBus({ std::move(number), std::move(stop_ptr), is_roundtrip });
     }
 
-    tc::Bus JsonReader::MakeBus(const json_reader::CommandDescription& command, tc::TransportCatalogue& catalogue) const
+    void CatalogueLoader::Finish() 
     {
-        // id: номер автобуса или название остановки
-        // description: маршрут или координаты
-        tc::Bus bus = { command.id, ParseRoute(command.description, catalogue), command.description.at("is_roundtrip"s).AsBool() };
-     
-        return bus;
+        for (const auto& [from, to, distance] : pending_distances_) 
+        {
+            catalogue_.SetDistance(catalogue_.GetStop(from), catalogue_.GetStop(to), distance);
+        }
+
+        for (auto& bus : pending_buses_) 
+        {
+            AddBus(std::move(bus.number), { bus.stops.begin(), bus.stops.end() }, bus.is_roundtrip);
+        }
+
+        pending_distances_.clear();
+        pending_distances_.shrink_to_fit();
+        pending_buses_.clear();
+        pending_buses_.shrink_to_fit();
     }
 
-    void JsonReader::AddDistance(const json_reader::CommandDescription& command, tc::TransportCatalogue& catalogue) const
+    std::unique_ptr<tc::TransportCatalogue> UpdateCatalogue(const tc::TransportCatalogue& source, const json::Array& base_requests) 
     {
-        for (const auto &road_distance : command.description.at("road_distances"s).AsDict()) 
+        // Действует последнее описание каждой остановки и каждого маршрута
+        std::unordered_map<std::string_view, const json::Dict*> stop_updates;
+        std::unordered_map<std::string_view, const json::Dict*> bus_updates;
+
+        for (const auto& request : base_requests) 
         {
-            // id: номер автобуса или название остановки
-            // description: маршрут или координаты
-            catalogue.SetDistance(catalogue.GetStop(command.id), catalogue.GetStop(road_distance.first), road_distance.second.AsInt());
+            const json::Dict& description = request.AsDict();
+            const std::string& type = description.at("type"s).AsString();
+
+            if (type == "Stop"s) 
+            {
+                stop_updates[description.at("name"s).AsString()] = &description;
+            }
+
+            else if (type == "Bus"s) 
+            {
+                bus_updates[description.at("name"s).AsString()] = &description;
+            }
         }
-    }
 
-    /*
-    * Обрабатывает поля CommandDescription
-    */
-    void JsonReader::ApplyCommands(tc::TransportCatalogue &catalogue) const 
-    {    
-        for (const auto& c : commands_) 
+        auto catalogue = std::make_unique<tc::TransportCatalogue>();
+
+        const auto get_stop = [&catalogue](std::string_view name) 
         {
-            // command: автобус или остановка 
-            if (c.command == "Stop"s) 
+            const tc::Stop* stop = catalogue->GetStop(name);
+
+            if (!stop) 
             {
-                // id: номер автобуса или название остановки
-                // description: маршрут или координаты
-                catalogue.AddStop(MakeStop(c));
+                throw std::logic_error("unknown stop in update: "s + std::string(name));
             }
+
+            return stop;
+        };
+
+        const auto make_stop = [](const std::string& name, const json::Dict& description) -> tc::Stop 
+        {
+            return { name, { description.at("latitude"s).AsDouble(), description.at("longitude"s).AsDouble() }, {} };
+        };
+
+        // Сначала добавляются все остановки, чтобы расстояния и маршруты могли ссылаться на любую из них
+        for (const auto& [name, stop] : source.GetAllStops()) 
+        {
+            const auto it = stop_updates.find(name);
+            catalogue->AddStop(it == stop_updates.end() ? tc::Stop{ stop->name, stop->coordinates, {} } : make_stop(stop->name, *it->second));
         }
 
-        for (const auto& c : commands_) 
+        for (const auto& [name, description] : stop_updates) 
         {
-            // command: автобус или остановка 
-            if (c.command == "Stop"s && c.description.count("road_distances"s)) 
+            if (!source.GetStop(name)) 
             {
-                AddDistance(c, catalogue);
+                catalogue->AddStop(make_stop(std::string(name), *description));
             }
         }
 
-        for (const auto& c : commands_) 
+        for (const auto& [stops, distance] : source.GetAllDistances()) 
+        {
+            catalogue->SetDistance(get_stop(stops.first->name), get_stop(stops.second->name), distance);
+        }
+
+        for (const auto& [name, description] : stop_updates) 
         {
-            // command: автобус или остановка
-            if (c.command == "Bus"s) 
+            if (!description->count("road_distances"s)) 
+            {
+                continue;
+            }
+
+            const tc::Stop* from = get_stop(name);
+
+            for (const auto& [stop_name, distance] : description->at("road_distances"s).AsDict()) 
             {
-                // id: номер автобуса или название остановки
-                // description: маршрут или координаты
-                catalogue.AddBus(MakeBus(c, catalogue));
+                catalogue->SetDistance(from, get_stop(stop_name), distance.AsInt());
             }
         }
+
+        for (const auto& [number, bus] : source.GetAllBuses()) 
+        {
+            if (bus_updates.count(number)) 
+            {
+                continue;
+            }
+
+            std::vector<const tc::Stop*> stops;
+            stops.reserve(bus->stops.size());
+
+            for (const tc::Stop* stop : bus->stops) 
+            {
+                stops.push_back(get_stop(stop->name));
+            }
+
+            catalogue->AddBus({ bus->number, std::move(stops), bus->is_roundtrip });
+        }
+
+        for (const auto& [number, description] : bus_updates) 
+        {
+            std::vector<const tc::Stop*> stops;
+
+            for (const auto& stop : description->at("stops"s).AsArray()) 
+            {
+                stops.push_back(get_stop(stop.AsString()));
+            }
+
+            catalogue->AddBus({ std::string(number), std::move(stops), description->at("is_roundtrip"s).AsBool() });
+        }
+
+        return catalogue;
     }
 
     const json::Node& JsonReader::GetRenderSettings() const 
     {
-        return document_.GetRoot().AsDict().at("render_settings"s);
+        return render_settings_;
     }
 
     const json::Node& JsonReader::GetRoutingSettings() const 
     {
-        return document_.GetRoot().AsDict().at("routing_settings"s);
+        return routing_settings_;
     }
 
-    const json::Node& JsonReader::GetBaseRequests() const 
+    const json::Node& JsonReader::GetSerializationSettings() const 
     {
-        return document_.GetRoot().AsDict().at("base_requests");
+        return serialization_settings_;
     }
 
     const json::Node& JsonReader::GetStatRequests() const 
     {
-        return document_.GetRoot().AsDict().at("stat_requests"s);
+        return stat_requests_;
+    }
+
+    RequestPlan JsonReader::PlanRequests(const json::Node& stat_requests) const 
+    {
+        RequestPlan plan;
+
+        if (!stat_requests.IsArray()) 
+        {
+            return plan;
+        }
+
+        for (const auto& request : stat_requests.AsArray()) 
+        {
+            const auto& type = request.AsDict().at("type").AsString();
+
+            const bool isochrone_map = type == "Isochrone" && request.AsDict().count("map"s) && request.AsDict().at("map"s).AsBool();
+
+            if (type == "Map" || type == "MapTile" || type == "RouteMap" || isochrone_map) 
+            {
+                plan.needs_renderer = true;
+            }
+
+            if ((type == "Map" && !request.AsDict().count("min_lat"s)) || type == "RouteMap" || isochrone_map) 
+            {
+                plan.needs_map = true;
+            }
+
+            if (type == "Route" || type == "RouteMap" || type == "RoutesFrom") 
+            {
+                plan.needs_router = true;
+            }
+
+            if (type == "Isochrone") 
+            {
+                plan.needs_graph = true;
+            }
+        }
+
+        return plan;
     }
 
     void JsonReader::FillTransportCatalogue(tc::TransportCatalogue& catalogue) 
     {
-        auto base_requests = document_.GetRoot().AsDict().at("base_requests"s).AsArray();
-        
-        for (const auto& base_request : base_requests) 
+        // Большой документ из файла читается в память целиком и разбирается на нескольких потоках
+        if (std::optional<std::string> text = ReadLargeInput()) 
         {
-            ParseRequest(base_request);
+            FillTransportCatalogue(*text, catalogue);
+            return;
         }
 
-        ApplyCommands(catalogue);
+        CatalogueLoader loader(catalogue);
+
+        json::LoadDictItems(input_, [this, &loader](const std::string& key, std::istream& input) 
+        {
+            if (key == "base_requests"s) 
+            {
+                json::LoadArrayItems(input, [&loader](json::Node request) 
+                {
+                    loader.Apply(request);
+                });
+            }
+
+            else 
+            {
+                StoreSection(key, json::LoadNode(input));
+            }
+        });
+
+        loader.Finish();
+    }
+
+    void JsonReader::FillTransportCatalogue(std::string_view text, tc::TransportCatalogue& catalogue) 
+    {
+        const size_t thread_count = parallel::GetThreadCount();
+        CatalogueLoader loader(catalogue);
+
+        for (const auto& [key, value] : json::SplitDictItems(text)) 
+        {
+            if (key == "base_requests"s) 
+            {
+                // Элементы разбираются параллельно, а применяются к справочнику по порядку
+                json::LoadArrayItemsParallel(value, thread_count, [&loader](json::Node request) 
+                {
+                    loader.Apply(request);
+                });
+            }
+
+            else if (key == "stat_requests"s) 
+            {
+                json::Array stat_requests;
+
+                json::LoadArrayItemsParallel(value, thread_count, [&stat_requests](json::Node request) 
+                {
+                    stat_requests.push_back(std::move(request));
+                });
+
+                StoreSection(key, std::move(stat_requests));
+            }
+
+            else 
+            {
+                StoreSection(key, json::LoadNode(value));
+            }
+        }
+
+        loader.Finish();
+    }
+
+    void JsonReader::StoreSection(const std::string& key, json::Node section) 
+    {
+        if (key == "stat_requests"s) 
+        {
+            stat_requests_ = std::move(section);
+        }
+
+        else if (key == "render_settings"s) 
+        {
+            render_settings_ = std::move(section);
+        }
+
+        else if (key == "routing_settings"s) 
+        {
+            routing_settings_ = std::move(section);
+        }
+
+        else if (key == "serialization_settings"s) 
+        {
+            serialization_settings_ = std::move(section);
+        }
+
+        else if (key == "output_settings"s) 
+        {
+            print_settings_ = FillPrintSettings(section);
+            response_cache_mode_ = FillResponseCacheMode(section);
+            startup_report_ = FillStartupReport(section);
+        }
+
+        // Неизвестные разделы документа пропускаются
+    }
+
+    std::optional<std::string> JsonReader::ReadLargeInput() 
+    {
+        // Размер известен только для потоков с произвольным доступом, например перенаправленного файла
+        if (!parallel_load_) 
+        {
+            return std::nullopt;
+        }
+
+        std::streambuf* buffer = input_.rdbuf();
+        const auto current = buffer->pubseekoff(0, std::ios::cur, std::ios::in);
+        const auto end = buffer->pubseekoff(0, std::ios::end, std::ios::in);
+
+        if (current == std::streampos(-1) || end == std::streampos(-1)) 
+        {
+            return std::nullopt;
+        }
+
+        buffer->pubseekpos(current, std::ios::in);
+        const auto size = static_cast<size_t>(end - current);
+
+        if (size < PARALLEL_LOAD_THRESHOLD) 
+        {
+            return std::nullopt;
+        }
+
+        std::string text(size, '\0');
+        input_.read(text.data(), static_cast<std::streamsize>(size));
+        text.resize(static_cast<size_t>(input_.gcount()));
+
+        return text;
+    }
+
+    void JsonReader::SetParallelLoad(bool enabled) 
+    {
+        parallel_load_ = enabled;
+    }
+
+    void JsonReader::SetCompactOutput() 
+    {
+        print_settings_.compact = true;
+    }
+
+    const json::PrintSettings& JsonReader::GetPrintSettings() const 
+    {
+        return print_settings_;
+    }
+
+    json::PrintSettings JsonReader::FillPrintSettings(const json::Node& settings) const
+    {
+        json::PrintSettings print_settings;
+        const json::Dict& request = settings.AsDict();
+
+        if (request.count("compact"s)) 
+        {
+            print_settings.compact = request.at("compact"s).AsBool();
+        }
+
+        return print_settings;
+    }
+
+    bool JsonReader::FillStartupReport(const json::Node& settings) const
+    {
+        const json::Dict& request = settings.AsDict();
+
+        return request.count("startup_report"s) && request.at("startup_report"s).AsBool();
+    }
+
+    bool JsonReader::GetStartupReport() const
+    {
+        return startup_report_;
+    }
+
+    ResponseCache::Mode JsonReader::FillResponseCacheMode(const json::Node& settings) const
+    {
+        const json::Dict& request = settings.AsDict();
+
+        if (!request.count("response_cache"s)) 
+        {
+            return ResponseCache::Mode::NONE;
+        }
+
+        const std::string& mode = request.at("response_cache"s).AsString();
+
+        if (mode == "lazy"s) 
+        {
+            return ResponseCache::Mode::LAZY;
+        }
+
+        else if (mode == "eager"s) 
+        {
+            return ResponseCache::Mode::EAGER;
+        }
+
+        else if (mode == "none"s) 
+        {
+            return ResponseCache::Mode::NONE;
+        }
+
+        throw std::logic_error("wrong response cache mode"s);
     }
 
     tc::RoutingSettings JsonReader::FillRoutingSettings(const json::Node& settings) const
@@ -145,9 +483,14 @@ namespace json_reader
         return tc::RoutingSettings{ settings.AsDict().at("bus_wait_time"s).AsInt(), settings.AsDict().at("bus_velocity"s).AsDouble() };
     }
 
+    std::string JsonReader::FillSerializationFile(const json::Node& settings) const
+    {
+        return settings.AsDict().at("file"s).AsString();
+    }
+
     renderer::MapRenderer JsonReader::FillRenderSettings(const json::Node& settings) const
     {
-        json::Dict request = settings.AsDict();
+        const json::Dict& request = settings.AsDict();
         renderer::RenderSettings render_settings;
 
         render_settings.width = request.at("width"s).AsDouble();
@@ -164,6 +507,48 @@ namespace json_reader
         render_settings.stop_label_offset = { stop_label_offset[0].AsDouble(), stop_label_offset[1].AsDouble() };
         
         ProcessColors(request, render_settings);
+
+        if (request.count("tile_cache_size"s)) 
+        {
+            const int tile_cache_size = request.at("tile_cache_size"s).AsInt();
+
+            if (tile_cache_size < 0) 
+            {
+                throw std::logic_error("wrong tile cache size"s);
+            }
+
+            render_settings.tile_cache_size = static_cast<size_t>(tile_cache_size);
+        }
+
+        if (request.count("compact_svg"s)) 
+        {
+            render_settings.compact_svg = request.at("compact_svg"s).AsBool();
+        }
+
+        if (request.count("svg_precision"s)) 
+        {
+            render_settings.svg_precision = request.at("svg_precision"s).AsInt();
+
+            if (render_settings.svg_precision < 0 || render_settings.svg_precision > 9) 
+            {
+                throw std::logic_error("wrong svg precision"s);
+            }
+        }
+
+        if (request.count("simplify_tolerance"s)) 
+        {
+            render_settings.simplify_tolerance = request.at("simplify_tolerance"s).AsDouble();
+
+            if (render_settings.simplify_tolerance < 0.0) 
+            {
+                throw std::logic_error("wrong simplify tolerance"s);
+            }
+        }
+
+        if (request.count("declutter_labels"s)) 
+        {
+            render_settings.declutter_labels = request.at("declutter_labels"s).AsBool();
+        }
         
         return render_settings;
     }
@@ -247,126 +632,248 @@ namespace json_reader
         }
     }
 
-    void JsonReader::ProcessRequests(const json::Node& stat_requests, tc::TransportCatalogue& catalogue, RequestHandler& request_handler) const 
+    std::unique_ptr<ResponseCache> JsonReader::MakeResponseCache(tc::TransportCatalogue& catalogue, RequestHandler& request_handler) const 
     {
-        json::Array result;
+        if (response_cache_mode_ == ResponseCache::Mode::NONE) 
+        {
+            return nullptr;
+        }
+
+        auto response_cache = std::make_unique<ResponseCache>(catalogue, print_settings_,
+            [this, &catalogue, &request_handler](std::string_view name, int id, json::Writer& writer) 
+            {
+                PrintStop(name, id, catalogue, request_handler, writer);
+            },
+            [this, &catalogue](std::string_view name, int id, json::Writer& writer) 
+            {
+                PrintBus(name, id, catalogue, writer);
+            });
+
+        if (response_cache_mode_ == ResponseCache::Mode::EAGER) 
+        {
+            response_cache->Prepare();
+        }
+
+        return response_cache;
+    }
+
+    void JsonReader::PrepareResponseCache(tc::TransportCatalogue& catalogue, RequestHandler& request_handler) 
+    {
+        if (!response_cache_) 
+        {
+            response_cache_ = MakeResponseCache(catalogue, request_handler);
+        }
+    }
+
+    void JsonReader::ProcessRequests(const json::Node& stat_requests, tc::TransportCatalogue& catalogue, RequestHandler& request_handler, std::ostream& output) 
+    {
+        PrepareResponseCache(catalogue, request_handler);
+        ProcessRequests(stat_requests, catalogue, request_handler, response_cache_.get(), output);
+    }
+
+    void JsonReader::ProcessRequests(const json::Node& stat_requests, tc::TransportCatalogue& catalogue, RequestHandler& request_handler, 
+                                     ResponseCache* response_cache, std::ostream& output) const 
+    {
+        // Ответы сериализуются сразу по мере вычисления, без накопления общего json::Array
+        json::Writer writer(output, print_settings_);
+        writer.StartArray();
 
         for (auto& request : stat_requests.AsArray()) 
         {
-            const auto& request_map = request.AsDict();
-            const auto& type = request_map.at("type").AsString();
+            ProcessRequest(request.AsDict(), catalogue, request_handler, response_cache, writer);
+        }
+        
+        writer.EndArray();
+    }
+
+    void JsonReader::ProcessRequest(const json::Dict& request_map, tc::TransportCatalogue& catalogue, RequestHandler& request_handler, 
+                                    ResponseCache* response_cache, json::Writer& writer) const 
+    {
+        const auto& type = request_map.at("type").AsString();
 
-            if (type == "Stop") 
+        if (type == "Stop") 
+        {
+            if (response_cache) 
             {
-                result.push_back(PrintStop(request_map, catalogue, request_handler).AsDict());
+                response_cache->WriteStop(request_map.at("name").AsString(), request_map.at("id").AsInt(), writer);
             }
 
-            if (type == "Bus") 
+            else 
             {
-                result.push_back(PrintBus(request_map, catalogue).AsDict());
+                PrintStop(request_map, catalogue, request_handler, writer);
             }
+        }
 
-            if (type == "Map")
+        if (type == "Bus") 
+        {
+            if (response_cache) 
             {
-                result.push_back(PrintMap(request_map, request_handler).AsDict());
+                response_cache->WriteBus(request_map.at("name").AsString(), request_map.at("id").AsInt(), writer);
             }
 
-            if (type == "Route")
+            else 
             {
-                result.push_back(PrintRoute(request_map, catalogue, request_handler).AsDict());
+                PrintBus(request_map, catalogue, writer);
             }
         }
-        
-        json::Print(json::Document{ result }, std::cout);
+
+        if (type == "Map")
+        {
+            PrintMap(request_map, request_handler, writer);
+        }
+
+        if (type == "MapTile")
+        {
+            PrintMapTile(request_map, request_handler, writer);
+        }
+
+        if (type == "Route")
+        {
+            PrintRoute(request_map, catalogue, request_handler, writer);
+        }
+
+        if (type == "Isochrone")
+        {
+            PrintIsochrone(request_map, catalogue, request_handler, writer);
+        }
+
+        if (type == "RoutesFrom")
+        {
+            PrintRoutesFrom(request_map, catalogue, request_handler, writer);
+        }
+
+        if (type == "RouteMap")
+        {
+            PrintRouteMap(request_map, catalogue, request_handler, writer);
+        }
     }
 
-    const json::Node JsonReader::PrintBus(const json::Dict& request, tc::TransportCatalogue& catalogue_) const 
+    // Ключи ответов выводятся в алфавитном порядке, как их упорядочивает json::Dict
+    void JsonReader::PrintNotFound(int id, json::Writer& writer) const 
     {
-        json::Node result;
+        writer.StartDict()
+              .Key("error_message"sv).Value("not found"sv)
+              .Key("request_id"sv).Value(id)
+              .EndDict();
+    }
 
-        const std::string& route_number = request.at("name").AsString();
+    void JsonReader::PrintBus(const json::Dict& request, tc::TransportCatalogue& catalogue_, json::Writer& writer) const 
+    {
+        PrintBus(request.at("name").AsString(), request.at("id").AsInt(), catalogue_, writer);
+    }
+
+    void JsonReader::PrintBus(std::string_view route_number, int id, tc::TransportCatalogue& catalogue_, json::Writer& writer) const 
+    {
         const tc::Bus* bus = catalogue_.GetBus(route_number);
-        const int id = request.at("id").AsInt();
 
         if (bus) 
         {
             const auto& bus_stat = catalogue_.GetBusStat(route_number);
 
-            result = json::Builder{}.StartDict()
-                                    .Key("request_id").Value(id)
-                                    .Key("curvature").Value(bus_stat->curvature)
-                                    .Key("route_length").Value(bus_stat->route_length)
-                                    .Key("stop_count").Value(static_cast<int>(bus_stat->total_stops))
-                                    .Key("unique_stop_count").Value(static_cast<int>(bus_stat->unique_stops))
-                                    .EndDict().Build();
+            writer.StartDict()
+                  .Key("curvature"sv).Value(bus_stat->curvature)
+                  .Key("request_id"sv).Value(id)
+                  .Key("route_length"sv).Value(bus_stat->route_length)
+                  .Key("stop_count"sv).Value(static_cast<int>(bus_stat->total_stops))
+                  .Key("unique_stop_count"sv).Value(static_cast<int>(bus_stat->unique_stops))
+                  .EndDict();
         }
 
         else 
         {
-            result = json::Builder{}.StartDict()
-                                    .Key("request_id").Value(id)
-                                    .Key("error_message").Value("not found")
-                                    .EndDict().Build();
+            PrintNotFound(id, writer);
         }
-        
-        return json::Node{ result };
     }
 
-    const json::Node JsonReader::PrintStop(const json::Dict& request, tc::TransportCatalogue& catalogue_, RequestHandler& request_handler) const 
+    void JsonReader::PrintStop(const json::Dict& request, tc::TransportCatalogue& catalogue_, RequestHandler& request_handler, json::Writer& writer) const 
     {
-            json::Node result;
-
-            const std::string& stop_name = request.at("name").AsString();
-            const tc::Stop* stop = catalogue_.GetStop(stop_name);
-            const int id = request.at("id").AsInt();
+        PrintStop(request.at("name").AsString(), request.at("id").AsInt(), catalogue_, request_handler, writer);
+    }
 
-            if (stop) 
-            {
-                json::Array buses;
+    void JsonReader::PrintStop(std::string_view stop_name, int id, tc::TransportCatalogue& catalogue_, RequestHandler& request_handler, json::Writer& writer) const 
+    {
+        const tc::Stop* stop = catalogue_.GetStop(stop_name);
 
-                for (const auto& bus : request_handler.GetBusesByStop(stop_name)) 
-                {
-                    buses.push_back(bus);
-                }
-                
-                result = json::Builder{}.StartDict()
-                                        .Key("request_id").Value(id)
-                                        .Key("buses").Value(buses)
-                                        .EndDict().Build();
-            }
+        if (stop) 
+        {
+            writer.StartDict()
+                  .Key("buses"sv).StartArray();
 
-            else 
+            for (const auto& bus : request_handler.GetBusesByStop(stop_name)) 
             {
-                result = json::Builder{}.StartDict()
-                                        .Key("request_id").Value(id)
-                                        .Key("error_message").Value("not found")
-                                        .EndDict().Build();
+                writer.Value(std::string_view(bus));
             }
 
-            return json::Node{ result };
+            writer.EndArray()
+                  .Key("request_id"sv).Value(id)
+                  .EndDict();
+        }
+
+        else 
+        {
+            PrintNotFound(id, writer);
         }
+    }
 
-        const json::Node JsonReader::PrintMap(const json::Dict& request, RequestHandler& request_handler) const 
+    void JsonReader::PrintMap(const json::Dict& request, RequestHandler& request_handler, json::Writer& writer) const 
+    {
+        if (request.count("min_lat"s)) 
         {
-            json::Node result;
+            PrintMapViewport(request, request_handler, writer);
+            return;
+        }
 
-            const int id = request.at("id").AsInt();
-            std::ostringstream strm;
-            svg::Document map = request_handler.RenderMap();
-            map.Render(strm);
+        const int id = request.at("id").AsInt();
 
-            result = json::Builder{}.StartDict()
-                                    .Key("request_id").Value(id)
-                                    .Key("map").Value(strm.str())
-                                    .EndDict().Build();
+        // Карта отрисовывается и экранируется один раз, далее её байты просто копируются в ответ
+        writer.StartDict()
+              .Key("map"sv).RawValue(request_handler.GetMapJson())
+              .Key("request_id"sv).Value(id)
+              .EndDict();
+    }
+
+    void JsonReader::PrintMapViewport(const json::Dict& request, RequestHandler& request_handler, json::Writer& writer) const 
+    {
+        const int id = request.at("id"s).AsInt();
+        renderer::Viewport viewport;
+        viewport.min = { request.at("min_lat"s).AsDouble(), request.at("min_lng"s).AsDouble() };
+        viewport.max = { request.at("max_lat"s).AsDouble(), request.at("max_lng"s).AsDouble() };
+        viewport.width = request.at("width"s).AsDouble();
+        viewport.height = request.at("height"s).AsDouble();
 
-            return json::Node{ result };
+        if (!renderer::MapRenderer::IsValidViewport(viewport)) 
+        {
+            PrintNotFound(id, writer);
+            return;
         }
 
-    const json::Node JsonReader::PrintRoute(const json::Dict& request, tc::TransportCatalogue& catalogue_, RequestHandler& request_handler) const 
+        writer.StartDict()
+              .Key("map"sv).RawValue(request_handler.GetMapViewportJson(viewport))
+              .Key("request_id"sv).Value(id)
+              .EndDict();
+    }
+
+    void JsonReader::PrintMapTile(const json::Dict& request, RequestHandler& request_handler, json::Writer& writer) const 
     {
-        json::Node result;
+        const int id = request.at("id"s).AsInt();
+        const int z = request.at("z"s).AsInt();
+        const int x = request.at("x"s).AsInt();
+        const int y = request.at("y"s).AsInt();
+
+        if (!renderer::MapRenderer::IsValidTile(z, x, y)) 
+        {
+            PrintNotFound(id, writer);
+            return;
+        }
+
+        writer.StartDict()
+              .Key("map"sv).RawValue(*request_handler.GetMapTileJson(z, x, y))
+              .Key("request_id"sv).Value(id)
+              .EndDict();
+    }
 
+    void JsonReader::PrintRoute(const json::Dict& request, tc::TransportCatalogue& catalogue_, RequestHandler& request_handler, json::Writer& writer) const 
+    {
         const int id = request.at("id"s).AsInt();
         const tc::Stop* from = catalogue_.GetStop(request.at("from"s).AsString());
         const tc::Stop* to = catalogue_.GetStop(request.at("to"s).AsString());
@@ -374,53 +881,245 @@ namespace json_reader
         
         if (route)
         {
-            json::Array items;
-            double total_time = 0.0;
-            items.reserve(route.value().edges.size());
+            writer.StartDict()
+                  .Key("items"sv);
+            const double total_time = PrintRouteItems(*route, request_handler, writer);
+            writer.Key("request_id"sv).Value(id)
+                  .Key("total_time"sv).Value(total_time)
+                  .EndDict();
+        }
+
+        else 
+        {
+            PrintNotFound(id, writer);
+        }
+    }
+
+    double JsonReader::PrintRouteItems(const graph::Router<double>::RouteInfo& route, RequestHandler& request_handler, json::Writer& writer) const 
+    {
+        double total_time = 0.0;
+        writer.StartArray();
+
+        for (auto& id : route.edges) 
+        {
+            const graph::Edge<double>& edge = request_handler.GetGraph().GetEdge(id);
 
-            for (auto& id : route.value().edges) 
+            if (edge.span_count == 0) 
             {
-                const graph::Edge<double> edge = request_handler.GetGraph().GetEdge(id);
+                writer.StartDict()
+                      .Key("stop_name"sv).Value(std::string_view(edge.name))
+                      .Key("time"sv).Value(edge.weight)
+                      .Key("type"sv).Value("Wait"sv)
+                      .EndDict();
+            }
 
-                if (edge.span_count == 0) 
-                {
-                   items.emplace_back(json::Node(json::Builder{}.StartDict()
-                                                                .Key("type"s).Value("Wait"s)
-                                                                .Key("stop_name"s).Value(edge.name)
-                                                                .Key("time"s).Value(edge.weight)
-                                                                .EndDict().Build()));
+            else 
+            {
+                writer.StartDict()
+                      .Key("bus"sv).Value(std::string_view(edge.name))
+                      .Key("span_count"sv).Value(static_cast<int>(edge.span_count))
+                      .Key("time"sv).Value(edge.weight)
+                      .Key("type"sv).Value("Bus"sv)
+                      .EndDict();
+            }
 
-                    total_time += edge.weight;
-                }
+            total_time += edge.weight;
+        }
 
-                else 
+        writer.EndArray();
+
+        return total_time;
+    }
+
+    void JsonReader::PrintRoutesFrom(const json::Dict& request, tc::TransportCatalogue& catalogue_, RequestHandler& request_handler, json::Writer& writer) const 
+    {
+        const int id = request.at("id"s).AsInt();
+        const tc::Stop* from = catalogue_.GetStop(request.at("from"s).AsString());
+        const bool itineraries = request.count("itineraries"s) && request.at("itineraries"s).AsBool();
+
+        if (!from) 
+        {
+            PrintNotFound(id, writer);
+            return;
+        }
+
+        // Одно дерево путей из from на все остановки назначения; ответы на них пишутся по мере обхода списка
+        const tc::TransportRouter::RoutesFrom routes = request_handler.GetRoutesFrom(from);
+
+        writer.StartDict()
+              .Key("request_id"sv).Value(id)
+              .Key("routes"sv).StartArray();
+
+        for (const json::Node& stop_name : request.at("to"s).AsArray()) 
+        {
+            const std::string& name = stop_name.AsString();
+            const tc::Stop* to = catalogue_.GetStop(name);
+            std::optional<graph::Router<double>::RouteInfo> route;
+            std::optional<double> total_time;
+
+            if (to && itineraries) 
+            {
+                route = routes.GetRoute(to);
+                total_time = route ? std::optional<double>(route->weight) : std::nullopt;
+            }
+
+            else if (to) 
+            {
+                total_time = routes.GetTotalTime(to);
+            }
+
+            writer.StartDict();
+
+            if (!total_time) 
+            {
+                writer.Key("error_message"sv).Value("not found"sv)
+                      .Key("stop_name"sv).Value(std::string_view(name));
+            }
+
+            else 
+            {
+                if (route) 
                 {
-                   items.emplace_back(json::Node(json::Builder{}.StartDict()
-                                                                .Key("type"s).Value("Bus"s)
-                                                                .Key("bus"s).Value(edge.name)
-                                                                .Key("span_count"s).Value(static_cast<int>(edge.span_count))
-                                                                .Key("time"s).Value(edge.weight)
-                                                                .EndDict().Build()));
-
-                    total_time += edge.weight;
+                    writer.Key("items"sv);
+                    PrintRouteItems(*route, request_handler, writer);
                 }
+
+                writer.Key("stop_name"sv).Value(std::string_view(name))
+                      .Key("total_time"sv).Value(*total_time);
             }
 
-            result = json::Builder{}.StartDict()
-                                    .Key("request_id"s).Value(id)
-                                    .Key("total_time"s).Value(total_time)
-                                    .Key("items"s).Value(items)
-                                    .EndDict().Build();
+            writer.EndDict();
+        }
+
+        writer.EndArray()
+              .EndDict();
+    }
+
+    void JsonReader::PrintRouteMap(const json::Dict& request, tc::TransportCatalogue& catalogue_, RequestHandler& request_handler, json::Writer& writer) const 
+    {
+        const int id = request.at("id"s).AsInt();
+        const tc::Stop* from = catalogue_.GetStop(request.at("from"s).AsString());
+        const tc::Stop* to = catalogue_.GetStop(request.at("to"s).AsString());
+        const bool overlay_only = request.count("overlay_only"s) && request.at("overlay_only"s).AsBool();
+
+        if (!from || !to) 
+        {
+            PrintNotFound(id, writer);
+            return;
+        }
+
+        const auto route = request_handler.GetRoute(from, to);
+
+        if (!route) 
+        {
+            PrintNotFound(id, writer);
+            return;
+        }
+
+        writer.StartDict()
+              .Key("map"sv);
+        PrintOverlay(request_handler.RenderRouteOverlay(*route), overlay_only, request_handler, writer);
+        writer.Key("request_id"sv).Value(id)
+              .EndDict();
+    }
+
+    void JsonReader::PrintOverlay(const svg::Document& overlay, bool overlay_only, RequestHandler& request_handler, json::Writer& writer) const 
+    {
+        if (overlay_only) 
+        {
+            std::string svg;
+            overlay.Render(svg);
+            writer.RawValue(json::EscapeString(svg));
         }
 
         else 
         {
-            result = json::Builder{}.StartDict()
-                                    .Key("request_id"s).Value(id)
-                                    .Key("error_message"s).Value("not found"s)
-                                    .EndDict().Build();
+            // Слой вставляется перед закрывающим тэгом готовой карты: её байты копируются в ответ без повторной отрисовки
+            std::string objects;
+            overlay.RenderObjects(objects);
+            const std::string escaped = json::EscapeString(objects);
+            const std::string_view map = request_handler.GetMapJson();
+            const size_t footer = map.rfind("</svg>"sv);
+
+            if (footer == std::string_view::npos) 
+            {
+                throw std::logic_error("map has no closing svg tag"s);
+            }
+
+            writer.RawValue(map.substr(0, footer))
+                  .Raw(std::string_view(escaped).substr(1, escaped.size() - 2))
+                  .Raw(map.substr(footer));
+        }
+    }
+
+    void JsonReader::PrintIsochrone(const json::Dict& request, tc::TransportCatalogue& catalogue_, RequestHandler& request_handler, json::Writer& writer) const 
+    {
+        const int id = request.at("id"s).AsInt();
+        const tc::Stop* from = catalogue_.GetStop(request.at("from"s).AsString());
+        const bool with_map = request.count("map"s) && request.at("map"s).AsBool();
+        const bool overlay_only = request.count("overlay_only"s) && request.at("overlay_only"s).AsBool();
+
+        if (!from) 
+        {
+            PrintNotFound(id, writer);
+            return;
+        }
+
+        // Верхние границы интервалов времени по возрастанию; последний интервал заканчивается на time_limit
+        std::vector<double> bands;
+
+        if (request.count("bands"s)) 
+        {
+            for (const json::Node& band : request.at("bands"s).AsArray()) 
+            {
+                bands.push_back(band.AsDouble());
+
+                // Интервал находится сдвигом вперёд только по возрастающим границам
+                if (bands.back() < 0 || (bands.size() > 1 && bands.back() <= bands[bands.size() - 2])) 
+                {
+                    throw std::logic_error("wrong isochrone bands"s);
+                }
+            }
+        }
+
+        const std::vector<tc::StopArrival> arrivals = request_handler.GetReachableStops(from, request.at("time_limit"s).AsDouble());
+        std::vector<renderer::IsochroneStop> stops;
+        stops.reserve(arrivals.size());
+
+        // Время в пути растёт по ходу списка, поэтому интервал находится сдвигом вперёд
+        size_t band = 0;
+
+        for (const tc::StopArrival& arrival : arrivals) 
+        {
+            while (band < bands.size() && bands[band] < arrival.time) 
+            {
+                ++band;
+            }
+
+            stops.push_back({ arrival.stop, band });
+        }
+
+        writer.StartDict();
+
+        if (with_map) 
+        {
+            writer.Key("map"sv);
+            PrintOverlay(request_handler.RenderIsochroneOverlay(stops), overlay_only, request_handler, writer);
+        }
+
+        writer.Key("request_id"sv).Value(id)
+              .Key("stops"sv).StartArray();
+
+        for (size_t i = 0; i < arrivals.size(); ++i) 
+        {
+            writer.StartDict()
+                  .Key("band"sv).Value(static_cast<int>(stops[i].band))
+                  .Key("stop_name"sv).Value(std::string_view(arrivals[i].stop->name))
+                  .Key("time"sv).Value(arrivals[i].time)
+                  .EndDict();
         }
 
-        return result;
+        writer.EndArray()
+              .EndDict();
     }
 } // end namespace json_reader
\ No newline at end of file
@@ -1,68 +1,180 @@
 #pragma once
 
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
 #include "json.h"
+#include "json_writer.h"
+#include "response_cache.h"
 #include "transport_catalogue.h"
 #include "map_renderer.h"
 #include "request_handler.h"
 
 namespace json_reader
 {
-    struct CommandDescription 
+    /*
+    * Применяет элементы base_requests к справочнику по мере их чтения из потока:
+    * остановки добавляются сразу, расстояния и маршруты — как только известны все упомянутые в них остановки.
+    * В памяти удерживаются только ссылки вперёд на ещё не встреченные остановки
+    */
+    class CatalogueLoader 
+    {
+        public:
+
+            explicit CatalogueLoader(tc::TransportCatalogue& catalogue)
+                : catalogue_(catalogue)
+                {}
+
+            // Обрабатывает очередной элемент base_requests
+            void Apply(const json::Node& request);
+            // Разрешает отложенные ссылки после окончания base_requests: сначала расстояния, затем маршруты
+            void Finish();
+
+        private:
+
+            // Расстояние до остановки, которая ещё не встречалась в base_requests
+            struct PendingDistance 
+            {
+                std::string from;
+                std::string to;
+                int distance = 0;
+            };
+
+            // Маршрут, часть остановок которого ещё не встречалась в base_requests
+            struct PendingBus 
+            {
+                std::string number;
+                std::vector<std::string> stops;
+                bool is_roundtrip = false;
+            };
+
+            void ApplyStop(const json::Dict& request);
+            void ApplyBus(const json::Dict& request);
+            void AddBus(std::string number, const std::vector<std::string_view>& stops, bool is_roundtrip);
+
+            tc::TransportCatalogue& catalogue_;
+            std::vector<PendingDistance> pending_distances_;
+            std::vector<PendingBus> pending_buses_;
+    };
+
+    /*
+    * Строит новый справочник: копию source, к которой применены элементы base_requests.
+    * Остановка или маршрут с уже известным названием заменяет прежние, с новым — добавляется.
+    * Расстояния из road_distances заменяют прежние, остальные расстояния сохраняются.
+    * source не меняется. Бросает std::logic_error при ссылке на неизвестную остановку
+    */
+    std::unique_ptr<tc::TransportCatalogue> UpdateCatalogue(const tc::TransportCatalogue& source, const json::Array& base_requests);
+
+    // Подсистемы, которые понадобятся для ответов на stat_requests
+    struct RequestPlan 
     {
-        // Определяет, задана ли команда (поле command непустое)
-        explicit operator bool() const 
-        {
-            return !command.empty();
-        }
-
-        bool operator!() const 
-        {
-            return !operator bool();
-        }
-
-        std::string command;      // Название команды (Stop или Bus)
-        std::string id;           // Номер маршрута или название остановки
-        json::Dict description;   // Параметры маршрута или кординаты
+        bool needs_renderer = false;
+        // Запросы Map без окна просмотра и RouteMap используют карту, отрисованную целиком
+        bool needs_map = false;
+        // Запросы Isochrone ищут по графу маршрутов, не строя таблицу путей
+        bool needs_graph = false;
+        // Запросы Route, RouteMap и RoutesFrom используют таблицу кратчайших путей между всеми парами вершин
+        bool needs_router = false;
     };
 
     class JsonReader 
     {
         public:
         
-            JsonReader(std::istream& document)
-                : document_(json::Load(document))
+            // Документ читается потоково при вызове FillTransportCatalogue
+            explicit JsonReader(std::istream& input)
+                : input_(input)
                 {}
 
-            const json::Node& GetBaseRequests() const;
             const json::Node& GetStatRequests() const;
             const json::Node& GetRenderSettings() const;
             const json::Node& GetRoutingSettings() const;
-            const json::Node PrintBus(const json::Dict& request, tc::TransportCatalogue& catalogue_) const;
-            const json::Node PrintStop(const json::Dict& request, tc::TransportCatalogue& catalogue_, RequestHandler& request_handler) const;
-            const json::Node PrintMap(const json::Dict& request, RequestHandler& request_handler) const;
-            const json::Node PrintRoute(const json::Dict& request, tc::TransportCatalogue& catalogue_, RequestHandler& request_handler) const;
-            void ProcessRequests(const json::Node& stat_requests, tc::TransportCatalogue& catalogue, RequestHandler& request_handler) const;
+            const json::Node& GetSerializationSettings() const;
+            // Просматривает stat_requests до ответов: Map и MapTile требуют визуализатор, Route — маршрутизатор, RouteMap — оба
+            RequestPlan PlanRequests(const json::Node& stat_requests) const;
+            void PrintBus(const json::Dict& request, tc::TransportCatalogue& catalogue_, json::Writer& writer) const;
+            void PrintBus(std::string_view route_number, int id, tc::TransportCatalogue& catalogue_, json::Writer& writer) const;
+            void PrintStop(const json::Dict& request, tc::TransportCatalogue& catalogue_, RequestHandler& request_handler, json::Writer& writer) const;
+            void PrintStop(std::string_view stop_name, int id, tc::TransportCatalogue& catalogue_, RequestHandler& request_handler, json::Writer& writer) const;
+            // Запрос Map; с ключами min_lat, min_lng, max_lat, max_lng, width и height выводится окно просмотра
+            void PrintMap(const json::Dict& request, RequestHandler& request_handler, json::Writer& writer) const;
+            // Запрос MapTile: фрагмент карты с координатами z, x, y
+            void PrintMapTile(const json::Dict& request, RequestHandler& request_handler, json::Writer& writer) const;
+            void PrintRoute(const json::Dict& request, tc::TransportCatalogue& catalogue_, RequestHandler& request_handler, json::Writer& writer) const;
+            // Маршруты из from в каждую остановку списка to; с "itineraries": true — вместе с поездками, иначе только время
+            void PrintRoutesFrom(const json::Dict& request, tc::TransportCatalogue& catalogue_, RequestHandler& request_handler, json::Writer& writer) const;
+            // Остановки, до которых из from можно доехать не дольше time_limit минут, с временем в пути и номером интервала из bands.
+            // С "map": true к ответу добавляется карта со слоем изохроны или, с "overlay_only": true, только этот слой.
+            // Бросает std::logic_error, если границы bands отрицательны или не возрастают
+            void PrintIsochrone(const json::Dict& request, tc::TransportCatalogue& catalogue_, RequestHandler& request_handler, json::Writer& writer) const;
+            // Запрос RouteMap: карта с найденным маршрутом from — to; с "overlay_only": true — только слой маршрута
+            void PrintRouteMap(const json::Dict& request, tc::TransportCatalogue& catalogue_, RequestHandler& request_handler, json::Writer& writer) const;
+            // Ответы записываются в output одним JSON-массивом; кэш ответов создаётся при первом вызове
+            void ProcessRequests(const json::Node& stat_requests, tc::TransportCatalogue& catalogue, RequestHandler& request_handler, std::ostream& output);
+            // То же с кэшем ответов, созданным MakeResponseCache для этого справочника, или без кэша (nullptr); допускает одновременные вызовы
+            void ProcessRequests(const json::Node& stat_requests, tc::TransportCatalogue& catalogue, RequestHandler& request_handler, 
+                                 ResponseCache* response_cache, std::ostream& output) const;
+            // Записывает в writer ответ на один запрос; на запрос неизвестного типа ничего не записывается
+            void ProcessRequest(const json::Dict& request, tc::TransportCatalogue& catalogue, RequestHandler& request_handler, 
+                                ResponseCache* response_cache, json::Writer& writer) const;
+            // Кэш ответов для справочника catalogue согласно output_settings; nullptr, если кэш выключен.
+            // Фрагменты ответов печатаются с текущими настройками вывода, поэтому SetCompactOutput вызывается раньше
+            std::unique_ptr<ResponseCache> MakeResponseCache(tc::TransportCatalogue& catalogue, RequestHandler& request_handler) const;
+            // Запрещает читать документ целиком, если во входном потоке за ним следуют другие документы
+            void SetParallelLoad(bool enabled);
+            // Включает вывод в одну строку независимо от output_settings; вызывается до первого ответа
+            void SetCompactOutput();
+            const json::PrintSettings& GetPrintSettings() const;
+            /*
+            * Читает документ из потока: элементы base_requests применяются к справочнику по одному, 
+            * не сохраняясь в памяти; остальные разделы сохраняются для последующих этапов
+            */
             void FillTransportCatalogue(tc::TransportCatalogue& catalogue);
+            // Загрузка документа, целиком прочитанного в память: base_requests и stat_requests разбираются параллельно
+            void FillTransportCatalogue(std::string_view text, tc::TransportCatalogue& catalogue);
             renderer::MapRenderer FillRenderSettings(const json::Node& settings) const;
             tc::RoutingSettings FillRoutingSettings(const json::Node& settings) const;
+            // Раздел serialization_settings: { "file": "<путь к снимку базы>" }
+            std::string FillSerializationFile(const json::Node& settings) const;
+            // Необязательный раздел output_settings: { "compact": true } включает вывод без отступов
+            json::PrintSettings FillPrintSettings(const json::Node& settings) const;
+            // "response_cache": "none" (по умолчанию), "lazy" или "eager" в разделе output_settings
+            ResponseCache::Mode FillResponseCacheMode(const json::Node& settings) const;
+            // "startup_report": true в разделе output_settings выводит в std::cerr времена этапов запуска
+            bool FillStartupReport(const json::Node& settings) const;
+            bool GetStartupReport() const;
 
         private:
+
+            // Документы от этого размера читаются в память целиком и разбираются параллельно
+            static constexpr size_t PARALLEL_LOAD_THRESHOLD = 16 * 1024 * 1024;
             
-            tc::Stop MakeStop(const json_reader::CommandDescription& c) const;
-            tc::Bus MakeBus(const json_reader::CommandDescription& c, tc::TransportCatalogue& catalogue) const;
+            // Сохраняет раздел документа, не относящийся к base_requests
+            void StoreSection(const std::string& key, json::Node section);
+            // Читает документ целиком, если поток позволяет узнать размер и он не меньше PARALLEL_LOAD_THRESHOLD
+            std::optional<std::string> ReadLargeInput();
+            void PrepareResponseCache(tc::TransportCatalogue& catalogue, RequestHandler& request_handler);
+            void PrintNotFound(int id, json::Writer& writer) const;
+            // Выводит значение "map": слой overlay отдельно или вставленным в готовую карту
+            void PrintOverlay(const svg::Document& overlay, bool overlay_only, RequestHandler& request_handler, json::Writer& writer) const;
+            // Выводит массив items маршрута и возвращает сумму времён его элементов
+            double PrintRouteItems(const graph::Router<double>::RouteInfo& route, RequestHandler& request_handler, json::Writer& writer) const;
+            void PrintMapViewport(const json::Dict& request, RequestHandler& request_handler, json::Writer& writer) const;
             void ProcessColors(const json::Dict& request, renderer::RenderSettings& render_settings) const;
             svg::Rgb MakeRGB(const json::Array& type) const;
             svg::Rgba MakeRGBA(const json::Array& type) const;
-            void AddDistance(const json_reader::CommandDescription& c, tc::TransportCatalogue& catalogue) const;
-            void ParseRequest(const json::Node &request);
-            static CommandDescription ParseCommandDescription(const json::Node &request);
-            /*
-            * Наполняет данными транспортный справочник, используя команды из commands_
-            */
-            void ApplyCommands(tc::TransportCatalogue &catalogue) const;
-            static std::vector<const tc::Stop*> ParseRoute(const json::Dict& description, tc::TransportCatalogue& catalogue);
             
-            json::Document document_;
-            std::vector<CommandDescription> commands_;
+            std::istream& input_;
+            json::Node stat_requests_;
+            json::Node render_settings_;
+            json::Node routing_settings_;
+            json::Node serialization_settings_;
+            json::PrintSettings print_settings_;
+            bool parallel_load_ = true;
+            bool startup_report_ = false;
+            ResponseCache::Mode response_cache_mode_ = ResponseCache::Mode::NONE;
+            std::unique_ptr<ResponseCache> response_cache_;
     };
 } // end namespace json_reader
\ No newline at end of file
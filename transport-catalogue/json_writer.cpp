@@ -0,0 +1,398 @@
+#include "json_writer.h"
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std::literals;
+
+namespace json
+{
+    namespace
+    {
+        constexpr uint64_t ONES = 0x0101010101010101ull;
+        constexpr uint64_t HIGH_BITS = 0x8080808080808080ull;
+
+        // Ненулевой результат, если среди восьми байт слова есть байт, равный byte
+        uint64_t HasByte(uint64_t word, uint8_t byte)
+        {
+            const uint64_t x = word ^ (ONES * byte);
+
+            return (x - ONES) & ~x & HIGH_BITS;
+        }
+
+        // Ненулевой результат, если среди восьми байт слова есть управляющий символ (меньше 0x20)
+        uint64_t HasControl(uint64_t word)
+        {
+            return (word - ONES * 0x20) & ~word & HIGH_BITS;
+        }
+
+        bool NeedsEscape(char c)
+        {
+            return c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20;
+        }
+
+        // Возвращает позицию первого символа, требующего экранирования, просматривая строку по восемь байт за раз
+        size_t FindSpecial(std::string_view value, size_t pos)
+        {
+            const size_t size = value.size();
+
+            for (; pos + sizeof(uint64_t) <= size; pos += sizeof(uint64_t))
+            {
+                uint64_t word;
+                std::memcpy(&word, value.data() + pos, sizeof(word));
+
+                if (HasByte(word, '"') | HasByte(word, '\\') | HasControl(word))
+                {
+                    break;
+                }
+            }
+
+            for (; pos < size && !NeedsEscape(value[pos]); ++pos)
+            {
+            }
+
+            return pos;
+        }
+    }  // end namespace
+
+    Writer::Writer(std::ostream& output, const PrintSettings& settings, size_t flush_threshold)
+        : output_(&output)
+        , settings_(settings)
+        , flush_threshold_(flush_threshold)
+        , buffer_(own_buffer_)
+    {
+        buffer_.reserve(flush_threshold_);
+    }
+
+    Writer::Writer(std::string& output, const PrintSettings& settings, size_t base_depth)
+        : settings_(settings)
+        , flush_threshold_(0)
+        , base_depth_(base_depth)
+        , buffer_(output)
+    {
+    }
+
+    Writer::~Writer()
+    {
+        Flush();
+    }
+
+    Writer& Writer::StartDict()
+    {
+        BeginValue();
+        buffer_.push_back('{');
+        levels_.push_back({ /* is_dict */ true });
+
+        return *this;
+    }
+
+    Writer& Writer::EndDict()
+    {
+        if (levels_.empty() || !levels_.back().is_dict || after_key_)
+        {
+            throw std::logic_error("EndDict() outside a dict"s);
+        }
+
+        EndContainer('}');
+
+        return *this;
+    }
+
+    Writer& Writer::StartArray()
+    {
+        BeginValue();
+        buffer_.push_back('[');
+        levels_.push_back({ /* is_dict */ false });
+
+        return *this;
+    }
+
+    Writer& Writer::EndArray()
+    {
+        if (levels_.empty() || levels_.back().is_dict)
+        {
+            throw std::logic_error("EndArray() outside an array"s);
+        }
+
+        EndContainer(']');
+
+        return *this;
+    }
+
+    Writer& Writer::Key(std::string_view key)
+    {
+        if (levels_.empty() || !levels_.back().is_dict || after_key_)
+        {
+            throw std::logic_error("Key() outside a dict"s);
+        }
+
+        Level& level = levels_.back();
+
+        if (!level.empty)
+        {
+            buffer_.push_back(',');
+        }
+
+        level.empty = false;
+        WriteNewLine(base_depth_ + levels_.size());
+        WriteString(key);
+        buffer_ += settings_.compact ? ":"sv : ": "sv;
+        after_key_ = true;
+
+        return *this;
+    }
+
+    Writer& Writer::Value(std::nullptr_t)
+    {
+        BeginValue();
+        buffer_ += "null"sv;
+        FlushIfNeeded();
+
+        return *this;
+    }
+
+    Writer& Writer::Value(bool value)
+    {
+        BeginValue();
+        buffer_ += value ? "true"sv : "false"sv;
+        FlushIfNeeded();
+
+        return *this;
+    }
+
+    Writer& Writer::Value(int value)
+    {
+        BeginValue();
+        char chars[16];
+        const auto result = std::to_chars(std::begin(chars), std::end(chars), value);
+        buffer_.append(chars, result.ptr);
+        FlushIfNeeded();
+
+        return *this;
+    }
+
+    Writer& Writer::Value(double value)
+    {
+        BeginValue();
+        // Кратчайшая запись, из которой читается ровно то же значение double
+        char chars[32];
+        const auto result = std::to_chars(std::begin(chars), std::end(chars), value);
+        buffer_.append(chars, result.ptr);
+        FlushIfNeeded();
+
+        return *this;
+    }
+
+    Writer& Writer::Value(std::string_view value)
+    {
+        BeginValue();
+        WriteString(value);
+        FlushIfNeeded();
+
+        return *this;
+    }
+
+    Writer& Writer::Value(const char* value)
+    {
+        return Value(std::string_view(value));
+    }
+
+    Writer& Writer::Value(const Node& node)
+    {
+        if (node.IsArray())
+        {
+            StartArray();
+
+            for (const Node& item : node.AsArray())
+            {
+                Value(item);
+            }
+
+            return EndArray();
+        }
+
+        if (node.IsDict())
+        {
+            StartDict();
+
+            for (const auto& [key, item] : node.AsDict())
+            {
+                Key(key).Value(item);
+            }
+
+            return EndDict();
+        }
+
+        if (node.IsString())
+        {
+            return Value(std::string_view(node.AsString()));
+        }
+
+        if (node.IsInt())
+        {
+            return Value(node.AsInt());
+        }
+
+        if (node.IsPureDouble())
+        {
+            return Value(node.AsDouble());
+        }
+
+        if (node.IsBool())
+        {
+            return Value(node.AsBool());
+        }
+
+        return Value(nullptr);
+    }
+
+    Writer& Writer::RawValue(std::string_view json)
+    {
+        BeginValue();
+        buffer_ += json;
+        FlushIfNeeded();
+
+        return *this;
+    }
+
+    Writer& Writer::Raw(std::string_view bytes)
+    {
+        buffer_ += bytes;
+        FlushIfNeeded();
+
+        return *this;
+    }
+
+    void Writer::Flush()
+    {
+        if (output_ && !buffer_.empty())
+        {
+            output_->write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+            buffer_.clear();
+        }
+    }
+
+    void Writer::BeginValue()
+    {
+        if (levels_.empty())
+        {
+            return;
+        }
+
+        Level& level = levels_.back();
+
+        if (level.is_dict)
+        {
+            if (!after_key_)
+            {
+                throw std::logic_error("Value() without Key() in a dict"s);
+            }
+
+            after_key_ = false;
+            return;
+        }
+
+        if (!level.empty)
+        {
+            buffer_.push_back(',');
+        }
+
+        level.empty = false;
+        WriteNewLine(base_depth_ + levels_.size());
+    }
+
+    void Writer::EndContainer(char close)
+    {
+        // Пустой контейнер в форматированном выводе занимает две строки, как и прежде в json::Print
+        if (levels_.back().empty && !settings_.compact)
+        {
+            buffer_.push_back('\n');
+        }
+
+        levels_.pop_back();
+        WriteNewLine(base_depth_ + levels_.size());
+        buffer_.push_back(close);
+        FlushIfNeeded();
+    }
+
+    void Writer::WriteNewLine(size_t depth)
+    {
+        if (!settings_.compact)
+        {
+            buffer_.push_back('\n');
+            buffer_.append(depth * INDENT_STEP, ' ');
+        }
+    }
+
+    void Writer::WriteString(std::string_view value)
+    {
+        buffer_.push_back('"');
+
+        for (size_t pos = 0; pos < value.size();)
+        {
+            // Участок без спецсимволов копируется одним вызовом
+            const size_t special = FindSpecial(value, pos);
+            buffer_.append(value.data() + pos, special - pos);
+
+            if (special == value.size())
+            {
+                break;
+            }
+
+            WriteEscaped(value[special]);
+            pos = special + 1;
+        }
+
+        buffer_.push_back('"');
+    }
+
+    void Writer::WriteEscaped(char c)
+    {
+        switch (c)
+        {
+            case '\r':
+                buffer_ += "\\r"sv;
+                break;
+            case '\n':
+                buffer_ += "\\n"sv;
+                break;
+            case '\t':
+                buffer_ += "\\t"sv;
+                break;
+            case '"':
+                buffer_ += "\\\""sv;
+                break;
+            case '\\':
+                buffer_ += "\\\\"sv;
+                break;
+            default:
+            {
+                // Прочие управляющие символы выводятся в виде \u00XX
+                static constexpr char HEX[] = "0123456789abcdef";
+                const auto code = static_cast<unsigned char>(c);
+                buffer_ += "\\u00"sv;
+                buffer_.push_back(HEX[code >> 4]);
+                buffer_.push_back(HEX[code & 0xF]);
+                break;
+            }
+        }
+    }
+
+    void Writer::FlushIfNeeded()
+    {
+        if (output_ && buffer_.size() >= flush_threshold_)
+        {
+            Flush();
+        }
+    }
+
+    std::string EscapeString(std::string_view value)
+    {
+        std::string result;
+        result.reserve(value.size() + 2);
+        Writer(result, PrintSettings{}).Value(value);
+
+        return result;
+    }
+}  // namespace json
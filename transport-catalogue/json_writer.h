@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "json.h"
+
+namespace json
+{
+    /*
+    * Потоковый сериализатор JSON. В отличие от json::Builder не строит дерево Node:
+    * каждое значение сразу записывается в буфер, а буфер сбрасывается в поток вывода
+    * по достижении порога. На Writer построен и json::Print.
+    * Числа форматируются через std::to_chars (double — кратчайшее представление, однозначно читаемое обратно),
+    * строки экранируются блоками: между спецсимволами байты копируются целиком.
+    * Порядок ключей словаря задаёт вызывающий код (json::Print выводит ключи по алфавиту).
+    */
+    class Writer
+    {
+        public:
+
+            // Порог для потоковой выдачи ответов: первые байты уходят в поток вывода как можно раньше
+            static constexpr size_t DEFAULT_FLUSH_THRESHOLD = 64 * 1024;
+            // Порог для вывода документа целиком: несколько крупных вызовов write
+            static constexpr size_t LARGE_FLUSH_THRESHOLD = 1024 * 1024;
+
+            explicit Writer(std::ostream& output, const PrintSettings& settings = {}, size_t flush_threshold = DEFAULT_FLUSH_THRESHOLD);
+            // Сериализация в строку без сброса в поток, например для подготовки заранее сериализованных фрагментов.
+            // base_depth — уровень вложенности, на котором фрагмент будет вставлен в итоговый документ
+            Writer(std::string& output, const PrintSettings& settings, size_t base_depth = 0);
+            // Недописанный буфер сбрасывается в поток при разрушении
+            ~Writer();
+
+            Writer(const Writer&) = delete;
+            Writer& operator=(const Writer&) = delete;
+
+            Writer& StartDict();
+            Writer& EndDict();
+            Writer& StartArray();
+            Writer& EndArray();
+            Writer& Key(std::string_view key);
+
+            Writer& Value(std::nullptr_t);
+            Writer& Value(bool value);
+            Writer& Value(int value);
+            Writer& Value(double value);
+            Writer& Value(std::string_view value);
+            // Без этой перегрузки строковый литерал был бы приведён к bool
+            Writer& Value(const char* value);
+            Writer& Value(const Node& node);
+            // Записывает заранее сериализованное значение: разделитель и отступ выводятся как для обычного значения
+            Writer& RawValue(std::string_view json);
+            // Дописывает байты как есть, продолжая значение, начатое RawValue
+            Writer& Raw(std::string_view bytes);
+
+            // Сбрасывает накопленный буфер в поток вывода
+            void Flush();
+
+        private:
+
+            // Открытый массив или словарь
+            struct Level
+            {
+                bool is_dict = false;
+                bool empty = true;
+            };
+
+            // Выводит разделитель и отступ перед очередным значением
+            void BeginValue();
+            void EndContainer(char close);
+            // В компактном режиме переводы строк и отступы не выводятся
+            void WriteNewLine(size_t depth);
+            void WriteString(std::string_view value);
+            void WriteEscaped(char c);
+            void FlushIfNeeded();
+
+            static constexpr int INDENT_STEP = 4;
+
+            // nullptr, если Writer пишет в строку
+            std::ostream* output_ = nullptr;
+            PrintSettings settings_;
+            size_t flush_threshold_;
+            size_t base_depth_ = 0;
+            std::string own_buffer_;
+            std::string& buffer_;
+            std::vector<Level> levels_;
+            // Был записан ключ словаря, ожидается его значение
+            bool after_key_ = false;
+    };
+
+    // Возвращает строку в виде JSON-литерала: в кавычках и с экранированием спецсимволов
+    std::string EscapeString(std::string_view value);
+}  // namespace json
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+/*
+* Потокобезопасный кэш ограниченного размера с вытеснением давно не использованных элементов (LRU).
+* Список хранит элементы от недавно использованных к давно не использованным,
+* хеш-таблица — положение элемента в списке
+*/
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class LruCache
+{
+    public:
+
+        // При нулевой ёмкости кэш ничего не хранит
+        explicit LruCache(size_t capacity)
+            : capacity_(capacity)
+            {}
+
+        std::optional<Value> Get(const Key& key)
+        {
+            std::lock_guard guard(mutex_);
+            const auto it = positions_.find(key);
+
+            if (it == positions_.end())
+            {
+                return std::nullopt;
+            }
+
+            // Найденный элемент становится самым недавно использованным
+            items_.splice(items_.begin(), items_, it->second);
+
+            return it->second->second;
+        }
+
+        void Put(const Key& key, Value value)
+        {
+            if (capacity_ == 0)
+            {
+                return;
+            }
+
+            std::lock_guard guard(mutex_);
+            const auto it = positions_.find(key);
+
+            if (it != positions_.end())
+            {
+                it->second->second = std::move(value);
+                items_.splice(items_.begin(), items_, it->second);
+                return;
+            }
+
+            if (items_.size() == capacity_)
+            {
+                positions_.erase(items_.back().first);
+                items_.pop_back();
+            }
+
+            items_.emplace_front(key, std::move(value));
+            positions_.emplace(key, items_.begin());
+        }
+
+    private:
+
+        using Items = std::list<std::pair<Key, Value>>;
+
+        const size_t capacity_;
+        std::mutex mutex_;
+        Items items_;
+        std::unordered_map<Key, typename Items::iterator, Hash> positions_;
+};
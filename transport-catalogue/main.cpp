@@ -1,20 +1,342 @@
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <csignal>
+#include <pthread.h>
+#endif
+
+#include "base_versions.h"
 #include "json_reader.h"
 #include "request_handler.h"
+#include "serialization.h"
+#include "server.h"
+#include "task_graph.h"
+
+using namespace std::literals;
+
+namespace
+{
+    /*
+    * Обработчик запросов, который строит визуализатор и маршрутизатор по настройкам документа при первом обращении.
+    * С previous_router маршрутизатор чинится по маршрутизатору прежней версии справочника, а не строится заново;
+    * тогда его нужно построить, пока previous_router жив
+    */
+    RequestHandler MakeRequestHandler(const json_reader::JsonReader& document, const tc::TransportCatalogue& catalogue,
+                                      const tc::TransportRouter* previous_router = nullptr)
+    {
+        return RequestHandler(catalogue,
+            [&document]()
+            {
+                return std::make_unique<renderer::MapRenderer>(document.FillRenderSettings(document.GetRenderSettings()));
+            },
+            [&document, &catalogue, previous_router]()
+            {
+                if (previous_router)
+                {
+                    return std::make_unique<tc::TransportRouter>(*previous_router, catalogue);
+                }
+
+                return std::make_unique<tc::TransportRouter>(document.FillRoutingSettings(document.GetRoutingSettings()), catalogue);
+            });
+    }
+
+    /*
+    * Запуск как граф задач: справочник заполняется по мере разбора документа, после чего маршрутизатор и карта,
+    * если они нужны stat_requests, готовятся параллельно с ответами. Ответы начинаются сразу после заполнения справочника:
+    * запросы Stop и Bus не ждут подсистем, а Route и Map ждут нужную подсистему внутри RequestHandler
+    */
+    void RunStartup(json_reader::JsonReader& document, tc::TransportCatalogue& catalogue, RequestHandler& request_handler,
+                    std::string answer_name, std::function<void()> answer)
+    {
+        startup::TaskGraph tasks;
+        json_reader::RequestPlan plan;
+
+        const auto filled = tasks.Add("catalogue"s, [&document, &catalogue]()
+        {
+            document.FillTransportCatalogue(catalogue);
+        });
+
+        const auto planned = tasks.Add("plan"s, [&document, &plan]()
+        {
+            plan = document.PlanRequests(document.GetStatRequests());
+        }, { filled });
+
+        const auto router = tasks.Add("router"s, [&request_handler, &plan]()
+        {
+            if (plan.needs_graph || plan.needs_router)
+            {
+                request_handler.GetRouter();
+            }
+        }, { planned });
+
+        const auto route_table = tasks.Add("route table"s, [&request_handler, &plan]()
+        {
+            if (plan.needs_router)
+            {
+                request_handler.GetRouter().BuildRouteTable();
+            }
+        }, { router });
+
+        const auto renderer = tasks.Add("renderer"s, [&request_handler, &plan]()
+        {
+            if (plan.needs_renderer || plan.needs_map)
+            {
+                request_handler.GetRenderer();
+            }
+        }, { planned });
+
+        const auto map = tasks.Add("map"s, [&request_handler, &plan]()
+        {
+            if (plan.needs_map)
+            {
+                request_handler.GetMapJson();
+            }
+        }, { renderer });
+
+        tasks.Add(std::move(answer_name), std::move(answer), { filled });
+
+        // Ответы, которым подсистема понадобилась раньше, чем её построила задача запуска, ждут эту задачу: ожидание видно в отчёте
+        request_handler.SetSubsystemWait([&tasks, router, route_table, renderer, map](RequestHandler::Subsystem subsystem)
+        {
+            switch (subsystem)
+            {
+                case RequestHandler::Subsystem::RENDERER:
+                    tasks.Await(renderer);
+                    break;
+
+                case RequestHandler::Subsystem::MAP:
+                    tasks.Await(map);
+                    break;
+
+                case RequestHandler::Subsystem::ROUTER:
+                    tasks.Await(router);
+                    break;
+
+                case RequestHandler::Subsystem::ROUTE_TABLE:
+                    tasks.Await(route_table);
+                    break;
+            }
+        });
+
+        tasks.Start();
+        tasks.Wait();
+        request_handler.SetSubsystemWait(nullptr);
+
+        if (document.GetStartupReport())
+        {
+            tasks.Report(std::cerr);
+        }
+    }
+
+    // Строит базу и сразу отвечает на запросы
+    void Run()
+    {
+        tc::TransportCatalogue catalogue;
+        json_reader::JsonReader document (std::cin);
+        RequestHandler request_handler = MakeRequestHandler(document, catalogue);
+
+        RunStartup(document, catalogue, request_handler, "requests"s, [&document, &catalogue, &request_handler]()
+        {
+            document.ProcessRequests(document.GetStatRequests(), catalogue, request_handler, std::cout);
+        });
+    }
+
+    // Строит базу по base_requests и настройкам и сохраняет её снимок в файл из serialization_settings
+    void MakeBase()
+    {
+        tc::TransportCatalogue catalogue;
+
+        json_reader::JsonReader document (std::cin);
+        document.FillTransportCatalogue(catalogue);
+
+        const renderer::MapRenderer renderer = document.FillRenderSettings(document.GetRenderSettings());
+        const tc::RoutingSettings routing_settings = document.FillRoutingSettings(document.GetRoutingSettings());
+        const tc::TransportRouter router = { routing_settings, catalogue };
+
+        std::ofstream output(document.FillSerializationFile(document.GetSerializationSettings()), std::ios::binary);
+        serialization::SaveSnapshot(output, catalogue, renderer.GetRenderSettings(), router);
+    }
 
-int main() 
+    // Загружает снимок базы и отвечает на stat_requests
+    void ProcessRequests()
+    {
+        tc::TransportCatalogue catalogue;
+
+        // Документ запросов не содержит base_requests: справочник заполняется из снимка
+        json_reader::JsonReader document (std::cin);
+        document.FillTransportCatalogue(catalogue);
+
+        const serialization::Snapshot snapshot = serialization::LoadSnapshot(document.FillSerializationFile(document.GetSerializationSettings()), catalogue);
+        const renderer::MapRenderer renderer(snapshot.render_settings);
+
+        RequestHandler request_handler(catalogue, renderer, *snapshot.router);
+        document.ProcessRequests(document.GetStatRequests(), catalogue, request_handler, std::cout);
+    }
+
+#if defined(__unix__) || defined(__APPLE__)
+    // Сигналы остановки сервера, слушающего сокет
+    sigset_t GetStopSignals()
+    {
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+
+        return signals;
+    }
+
+    // Принимает соединения, пока не придёт SIGINT или SIGTERM. Сигналы должны быть заблокированы во всех потоках процесса
+    void ListenUntilStopped(server::QueryServer& server, const char* socket_path)
+    {
+        const sigset_t stop_signals = GetStopSignals();
+
+        std::thread stopper([&server, &stop_signals]()
+        {
+            int signal = 0;
+            sigwait(&stop_signals, &signal);
+            server.Stop();
+        });
+
+        try
+        {
+            server.Listen(socket_path);
+        }
+        catch (...)
+        {
+            // Поток остановки ждёт сигнала: посланный ему сигнал его завершает
+            pthread_kill(stopper.native_handle(), SIGTERM);
+            stopper.join();
+            throw;
+        }
+
+        stopper.join();
+    }
+#else
+    void ListenUntilStopped(server::QueryServer& server, const char* socket_path)
+    {
+        server.Listen(socket_path);
+    }
+#endif
+
+    /*
+    * Строит базу по документу из std::cin и отвечает на запросы, не перестраивая её.
+    * Без socket_path запросы читаются из std::cin следом за документом базы, иначе принимаются по сокету.
+    * Обновления публикуют новые версии базы. Если у прежней версии уже есть маршрутизатор, маршрутизатор новой версии
+    * чинится по нему сразу при обновлении; иначе он, как и карта, строится при первом обращении.
+    * Сервер на сокете останавливается по SIGINT или SIGTERM, дождавшись ответов на полученные запросы
+    */
+    void Serve(const char* socket_path, server::QueryServer::Protocol protocol)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        // Сигналы остановки принимает один поток; блокировку наследуют все потоки, запущенные после этой точки
+        if (socket_path)
+        {
+            const sigset_t stop_signals = GetStopSignals();
+            pthread_sigmask(SIG_BLOCK, &stop_signals, nullptr);
+        }
+#endif
+
+        // Первая версия живёт до конца Serve: задачи запуска могут достраивать её после замены
+        auto catalogue = std::make_shared<tc::TransportCatalogue>();
+        json_reader::JsonReader document (std::cin);
+        // За документом базы в std::cin могут следовать пакеты, поэтому он не читается целиком
+        document.SetParallelLoad(socket_path != nullptr);
+        auto request_handler = std::make_shared<RequestHandler>(MakeRequestHandler(document, *catalogue));
+
+        RunStartup(document, *catalogue, *request_handler, "serve"s, [&]()
+        {
+            const auto build = [&document](const server::BaseVersion& previous, server::BaseVersion& version)
+            {
+                const tc::TransportRouter* previous_router = previous.request_handler->FindRouter();
+                version.request_handler = std::make_shared<RequestHandler>(MakeRequestHandler(document, *version.catalogue, previous_router));
+
+                if (previous_router)
+                {
+                    version.request_handler->GetRouter();
+                }
+
+                version.response_cache = document.MakeResponseCache(*version.catalogue, *version.request_handler);
+            };
+
+            auto first = std::make_unique<server::BaseVersion>();
+            first->catalogue = catalogue;
+            first->request_handler = request_handler;
+
+            // Кэш ответов хранит готовые фрагменты, поэтому формат вывода протокола задаётся до его создания
+            if (protocol == server::QueryServer::Protocol::NDJSON)
+            {
+                document.SetCompactOutput();
+            }
+
+            // Кэш ответов создаётся до появления параллельных клиентов
+            first->response_cache = document.MakeResponseCache(*catalogue, *request_handler);
+
+            server::VersionedBase base(std::move(first), build);
+            server::QueryServer server(document, base, protocol);
+
+            // stat_requests из документа базы обслуживаются как первый пакет
+            if (document.GetStatRequests().IsArray())
+            {
+                server.ProcessRequests(document.GetStatRequests(), std::cout);
+            }
+
+            if (socket_path)
+            {
+                ListenUntilStopped(server, socket_path);
+            }
+
+            else
+            {
+                server.Serve(std::cin, std::cout);
+            }
+        });
+    }
+}  // end namespace
+
+int main(int argc, char* argv[])
 {
-    tc::TransportCatalogue catalogue;
+    const std::string_view mode = argc > 1 ? argv[1] : ""sv;
+
+    if (mode.empty())
+    {
+        Run();
+    }
+
+    else if (mode == "make_base"sv)
+    {
+        MakeBase();
+    }
+
+    else if (mode == "process_requests"sv)
+    {
+        ProcessRequests();
+    }
+
+    else if (mode == "serve"sv)
+    {
+        int arg = 2;
+        auto protocol = server::QueryServer::Protocol::BATCH;
 
-    json_reader::JsonReader document (std::cin);
-    document.FillTransportCatalogue(catalogue);
+        if (arg < argc && argv[arg] == "--ndjson"sv)
+        {
+            protocol = server::QueryServer::Protocol::NDJSON;
+            ++arg;
+        }
 
-    const json::Node& stat_requests = document.GetStatRequests();
-    const renderer::MapRenderer& renderer = document.FillRenderSettings(document.GetRenderSettings());
-    const tc::RoutingSettings routing_settings = document.FillRoutingSettings(document.GetRoutingSettings());
-    const tc::TransportRouter router = { routing_settings, catalogue };
+        Serve(arg < argc ? argv[arg] : nullptr, protocol);
+    }
 
-    RequestHandler request_handler(catalogue, renderer, router);
-    document.ProcessRequests(stat_requests, catalogue, request_handler);
+    else
+    {
+        std::cerr << "Usage: transport_catalogue [make_base|process_requests|serve [--ndjson] [socket_path]]"sv << std::endl;
+        return 1;
+    }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -1,4 +1,10 @@
 #include "map_renderer.h"
+#include "json_writer.h"
+#include "parallel.h"
+#include <cmath>
+#include <iterator>
+#include <stdexcept>
+#include <tuple>
 
 using namespace std::literals;
 
@@ -9,129 +15,386 @@ namespace renderer
         return std::abs(value) < EPSILON;
     }
 
-    std::vector<svg::Polyline> MapRenderer::RenderRouteLines(const std::map<std::string_view, const tc::Bus*>& buses, const SphereProjector& sphere_projector) const 
+    MapLayout MapRenderer::BuildLayout(const std::map<std::string_view, const tc::Bus*>& buses) const 
     {
-        std::vector<svg::Polyline> lines;
-        // Первый по алфавиту маршрут должен получить первый цвет, второй маршрут — второй цвет и так далее
-        size_t color = 0;
+        MapLayout layout;
 
-        for (const auto &[bus_number, bus] : buses) 
+        // Общие для нескольких маршрутов остановки попадают в раскладку один раз
+        for (const auto& [bus_number, bus] : buses) 
         {
-            if (!bus->stops.empty()) 
+            for (const auto& stop : bus->stops) 
             {
-                std::vector<const tc::Stop*> route_stops{ bus->stops.begin(), bus->stops.end() };
-
-                // Если маршрут некольцевой, то есть "is_roundtrip": false, 
-                // каждый отрезок между соседними остановками должен быть нарисован дважды: 
-                // сначала в прямом, а потом в обратном направлении
-                if (!bus->is_roundtrip) 
+                if (layout.stop_index.emplace(stop, 0).second) 
                 {
-                    route_stops.insert(route_stops.end(), std::next(bus->stops.rbegin()), bus->stops.rend());
+                    layout.stops.push_back(stop);
                 }
+            }
+        }
 
-                svg::Polyline line;
+        std::sort(layout.stops.begin(), layout.stops.end(), [](const tc::Stop* lhs, const tc::Stop* rhs) 
+        {
+            return lhs->name < rhs->name;
+        });
 
-                for (const auto &stop : route_stops) 
-                {
-                    line.AddPoint(sphere_projector(stop->coordinates));
-                }
+        std::vector<geo::Coordinates> stop_coordinates;
+        stop_coordinates.reserve(layout.stops.size());
 
-                // Цвет линии stroke определён по правилам выше
-                line.SetStrokeColor(render_settings_.color_palette[color]);
-                // Цвет заливки fill должен иметь значение none
-                line.SetFillColor("none");
-                // Толщина линии stroke-width равна настройке line_width
-                line.SetStrokeWidth(render_settings_.line_width);
-                // Формы конца линии stroke-linecap и соединений stroke-linejoin равны round
-                line.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
-                line.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
-                
-                if (color < render_settings_.color_palette.size() - 1) 
-                {
-                    ++color;
-                } 
-                
-                else 
-                {
-                    color = 0;
-                }
-                
-                lines.push_back(line);
+        for (size_t i = 0; i < layout.stops.size(); ++i) 
+        {
+            layout.stop_index[layout.stops[i]] = i;
+            stop_coordinates.push_back(layout.stops[i]->coordinates);
+        }
+
+        const SphereProjector& sphere_projector = layout.projector.emplace(stop_coordinates.begin(), stop_coordinates.end(), 
+            render_settings_.width, render_settings_.height, render_settings_.padding);
+        layout.points.reserve(stop_coordinates.size());
+
+        for (const auto& coordinates : stop_coordinates) 
+        {
+            layout.points.push_back(sphere_projector(coordinates));
+        }
+
+        for (const auto& [bus_number, bus] : buses) 
+        {
+            if (bus->stops.empty()) 
+            {
+                continue;
             }
+
+            MapLayout::Route route{ bus, {} };
+            route.stop_indices.reserve(bus->stops.size());
+
+            for (const auto& stop : bus->stops) 
+            {
+                route.stop_indices.push_back(layout.stop_index.at(stop));
+            }
+
+            layout.routes.push_back(std::move(route));
+        }
+
+        return layout;
+    }
+
+    std::vector<size_t> MapLayout::Route::Path() const 
+    {
+        std::vector<size_t> path{ stop_indices.begin(), stop_indices.end() };
+
+        // Если маршрут некольцевой, то есть "is_roundtrip": false, 
+        // каждый отрезок между соседними остановками должен быть нарисован дважды: 
+        // сначала в прямом, а потом в обратном направлении
+        if (!bus->is_roundtrip) 
+        {
+            path.insert(path.end(), std::next(stop_indices.rbegin()), stop_indices.rend());
+        }
+
+        return path;
+    }
+
+    size_t MapRenderer::GetPaletteIndex(size_t index) const 
+    {
+        // Пустая палитра допустима, пока цвет не нужен: например, в базе без запросов карты
+        if (render_settings_.color_palette.empty()) 
+        {
+            throw std::logic_error("empty color palette"s);
+        }
+
+        return index % render_settings_.color_palette.size();
+    }
+
+    svg::Polyline MapRenderer::MakeRouteLine(size_t route_index) const 
+    {
+        svg::Polyline line;
+
+        // Оформление задаётся классами таблицы стилей: общим для линий и классом цвета
+        if (render_settings_.compact_svg) 
+        {
+            line.SetPathEncoding(render_settings_.svg_precision);
+            line.SetClass("l c"s + std::to_string(GetPaletteIndex(route_index)));
+
+            return line;
+        }
+
+        // Первый по алфавиту маршрут должен получить первый цвет, второй маршрут — второй цвет и так далее
+        line.SetStrokeColor(render_settings_.color_palette[GetPaletteIndex(route_index)]);
+        // Цвет заливки fill должен иметь значение none
+        line.SetFillColor("none");
+        // Толщина линии stroke-width равна настройке line_width
+        line.SetStrokeWidth(render_settings_.line_width);
+        // Формы конца линии stroke-linecap и соединений stroke-linejoin равны round
+        line.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
+        line.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+
+        return line;
+    }
+
+    std::vector<svg::Text> MapRenderer::MakeBusLabel(const tc::Bus& bus, svg::Point position, size_t route_index) const 
+    {
+        svg::Text text;
+        svg::Text underlayer;
+
+        if (render_settings_.compact_svg) 
+        {
+            // Подложка рисуется обводкой той же надписи (класс u)
+            text.SetPosition(RoundPoint(position)).SetOffset(render_settings_.bus_label_offset).SetFontSize(std::nullopt)
+                .SetData(bus.number).SetClass("b u f"s + std::to_string(GetPaletteIndex(route_index)));
+
+            return { std::move(text) };
         }
+
+        // x и y — координаты соответствующей конечной остановки
+        text.SetPosition(position);
+        // смещение dx и dy равно настройке bus_label_offset;
+        text.SetOffset(render_settings_.bus_label_offset);
+        // размер шрифта font-size равен настройке bus_label_font_size
+        text.SetFontSize(render_settings_.bus_label_font_size);
+        // название шрифта font-family — "Verdana"
+        text.SetFontFamily("Verdana"s);
+        // толщина шрифта font-weight — "bold"
+        text.SetFontWeight("bold"s);
+        // содержимое — название автобуса
+        text.SetData(bus.number);
+        // Цвет маршрута
+        text.SetFillColor(render_settings_.color_palette[GetPaletteIndex(route_index)]);
         
-        return lines;
+        // Дополнительные свойства подложки:
+        underlayer.SetPosition(position);
+        underlayer.SetOffset(render_settings_.bus_label_offset);
+        underlayer.SetFontSize(render_settings_.bus_label_font_size);
+        underlayer.SetFontFamily("Verdana"s);
+        underlayer.SetFontWeight("bold"s);
+        underlayer.SetData(bus.number);
+        // цвет заливки fill и цвет линий stroke равны настройке underlayer_color
+        underlayer.SetFillColor(render_settings_.underlayer_color);
+        underlayer.SetStrokeColor(render_settings_.underlayer_color);
+        // толщина линий stroke-width равна настройке underlayer_width
+        underlayer.SetStrokeWidth(render_settings_.underlayer_width);
+        // формы конца линии stroke-linecap и соединений stroke-linejoin равны round
+        underlayer.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
+        underlayer.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+
+        std::vector<svg::Text> texts;
+        texts.reserve(2);
+        texts.push_back(std::move(underlayer));
+        texts.push_back(std::move(text));
+
+        return texts;
+    }
+
+    svg::Circle MapRenderer::MakeStopPoint(svg::Point position) const 
+    {
+        // Каждая остановка маршрута изображается на карте в виде кружочков белого цвета
+        svg::Circle circle;
+        // координаты центра cx и cy — координаты соответствующей остановки на карте
+        circle.SetCenter(position);
+        // радиус r равен настройке stop_radius из словаря render_settings
+        circle.SetRadius(render_settings_.stop_radius);
+
+        if (render_settings_.compact_svg) 
+        {
+            circle.SetCenter(RoundPoint(position)).SetClass("p"s);
+
+            return circle;
+        }
+
+        // цвет заливки fill — "white"
+        circle.SetFillColor("white"s);
+
+        return circle;
     }
 
-    std::vector<svg::Text> MapRenderer::RenderBusLabel(const std::map<std::string_view, const tc::Bus*>& buses, const SphereProjector& sphere_projector) const 
+    std::vector<svg::Text> MapRenderer::MakeStopLabel(const tc::Stop& stop, svg::Point position) const 
     {
         svg::Text text;
         svg::Text underlayer;
-        std::vector<svg::Text> bus_labels;
-        // Первый по алфавиту маршрут должен получить первый цвет, второй маршрут — второй цвет и так далее
-        size_t color = 0;
 
-        for (const auto& [bus_number, bus] : buses) 
+        if (render_settings_.compact_svg) 
+        {
+            text.SetPosition(RoundPoint(position)).SetOffset(render_settings_.stop_label_offset).SetFontSize(std::nullopt)
+                .SetData(stop.name).SetClass("s u n"s);
+
+            return { std::move(text) };
+        }
+
+        text.SetFillColor("black"s);
+        // x и y — координаты соответствующей остановки
+        text.SetPosition(position);
+        // смещение dx и dy равно настройке stop_label_offset
+        text.SetOffset(render_settings_.stop_label_offset);
+        // размер шрифта font-size равен настройке stop_label_font_size
+        text.SetFontSize(render_settings_.stop_label_font_size);
+        // название шрифта font-family — "Verdana"
+        text.SetFontFamily("Verdana"s);
+        // свойства font-weight быть не должно, содержимое — название остановки
+        text.SetData(stop.name);
+        
+        // Дополнительные свойства подложки:
+        underlayer.SetPosition(position);
+        underlayer.SetOffset(render_settings_.stop_label_offset);
+        underlayer.SetFontSize(render_settings_.stop_label_font_size);
+        underlayer.SetFontFamily("Verdana");
+        underlayer.SetData(stop.name);
+
+        // цвет заливки fill и цвет линий stroke равны настройке underlayer_color
+        underlayer.SetFillColor(render_settings_.underlayer_color);
+        underlayer.SetStrokeColor(render_settings_.underlayer_color);
+        // толщина линий stroke-width равна настройке underlayer_width
+        underlayer.SetStrokeWidth(render_settings_.underlayer_width);
+        // формы конца линии stroke-linecap и соединений stroke-linejoin равны "round"
+        underlayer.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
+        underlayer.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+
+        std::vector<svg::Text> texts;
+        texts.reserve(2);
+        texts.push_back(std::move(underlayer));
+        texts.push_back(std::move(text));
+
+        return texts;
+    }
+
+    svg::Point MapRenderer::RoundPoint(svg::Point point) const 
+    {
+        const double scale = std::pow(10.0, render_settings_.svg_precision);
+
+        return { std::round(point.x * scale) / scale, std::round(point.y * scale) / scale };
+    }
+
+    void MapRenderer::AddStyleSheet(svg::Document& document) const 
+    {
+        if (!render_settings_.compact_svg) 
         {
-            // Если остановок у маршрута нет, его название выводиться не должно
-            if (!bus->stops.empty()) 
-            {
-                // x и y — координаты соответствующей конечной остановки (конечной считается первая остановка маршрута)
-                text.SetPosition(sphere_projector(bus->stops.front()->coordinates));
-                // смещение dx и dy равно настройке bus_label_offset;
-                text.SetOffset(render_settings_.bus_label_offset);
-                // размер шрифта font-size равен настройке bus_label_font_size
-                text.SetFontSize(render_settings_.bus_label_font_size);
-                // название шрифта font-family — "Verdana"
-                text.SetFontFamily("Verdana"s);
-                // толщина шрифта font-weight — "bold"
-                text.SetFontWeight("bold"s);
-                // содержимое — название автобуса
-                text.SetData(bus->number);
-                // Цвет маршрута
-                text.SetFillColor(render_settings_.color_palette[color]);
-                
-                // Дополнительные свойства подложки:
-                underlayer.SetPosition(sphere_projector(bus->stops.front()->coordinates));
-                underlayer.SetOffset(render_settings_.bus_label_offset);
-                underlayer.SetFontSize(render_settings_.bus_label_font_size);
-                underlayer.SetFontFamily("Verdana"s);
-                underlayer.SetFontWeight("bold"s);
-                underlayer.SetData(bus->number);
-                // цвет заливки fill и цвет линий stroke равны настройке underlayer_color
-                underlayer.SetFillColor(render_settings_.underlayer_color);
-                underlayer.SetStrokeColor(render_settings_.underlayer_color);
-                // толщина линий stroke-width равна настройке underlayer_width
-                underlayer.SetStrokeWidth(render_settings_.underlayer_width);
-                // формы конца линии stroke-linecap и соединений stroke-linejoin равны round
-                underlayer.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
-                underlayer.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
-                
-                bus_labels.push_back(underlayer);
-                bus_labels.push_back(text);
-                
-                // Название маршрута должно отрисовываться у каждой из его конечных остановок.
-                // В некольцевом маршруте — когда "is_roundtrip": false — конечной считается первая и последняя остановки маршрута
-                if (!bus->is_roundtrip && bus->stops.front() != bus->stops.back()) 
+            return;
+        }
+
+        std::string css;
+        svg::OutputBuffer out(css);
+        // Линии маршрутов и их цвета
+        out << ".l{fill:none;stroke-width:"sv << render_settings_.line_width << ";stroke-linecap:round;stroke-linejoin:round}"sv;
+
+        for (size_t i = 0; i < render_settings_.color_palette.size(); ++i) 
+        {
+            const int index = static_cast<int>(i);
+            out << ".c"sv << index << "{stroke:"sv << render_settings_.color_palette[i] << '}';
+            out << ".f"sv << index << "{fill:"sv << render_settings_.color_palette[i] << '}';
+        }
+
+        // Шрифты названий маршрутов и остановок, цвет названий и кружков остановок
+        // Подложка — обводка надписи, которая рисуется под заливкой (paint-order)
+        out << ".u{stroke:"sv << render_settings_.underlayer_color << ";stroke-width:"sv << render_settings_.underlayer_width 
+            << ";stroke-linecap:round;stroke-linejoin:round;paint-order:stroke}"sv;
+        out << ".b{font-family:Verdana;font-size:"sv << render_settings_.bus_label_font_size << "px;font-weight:bold}"sv;
+        out << ".s{font-family:Verdana;font-size:"sv << render_settings_.stop_label_font_size << "px}"sv;
+        out << ".n{fill:black}.p{fill:white}"sv;
+
+        document.Add(svg::StyleSheet().SetCss(std::move(css)));
+    }
+
+    Rect MapRenderer::EstimateLabelBox(std::string_view data, svg::Point offset, int font_size) const 
+    {
+        // Ширина символа Verdana не превышает 0.7 кегля; длина в байтах UTF-8 не меньше числа символов
+        const double width = 0.7 * font_size * data.size();
+        const double half_stroke = render_settings_.underlayer_width / 2;
+
+        // Опорная точка текста лежит на базовой линии: надпись занимает кегль над ней и выносные элементы под ней
+        return { offset.x - half_stroke, offset.y - font_size - half_stroke, 
+                 offset.x + width + half_stroke, offset.y + 0.3 * font_size + half_stroke };
+    }
+
+    Rect MapRenderer::EstimateLabelFootprint(std::string_view data, svg::Point offset, int font_size) const 
+    {
+        // Средняя ширина символа Verdana около 0.6 кегля; в UTF-8 символ начинается с любого байта, кроме продолжающих
+        const auto chars = std::count_if(data.begin(), data.end(), [](char c) 
+        {
+            return (static_cast<unsigned char>(c) & 0xC0) != 0x80;
+        });
+        const double width = 0.6 * font_size * chars;
+        const double half_stroke = render_settings_.underlayer_width / 2;
+
+        return { offset.x - half_stroke, offset.y - 0.8 * font_size - half_stroke, 
+                 offset.x + width + half_stroke, offset.y + 0.2 * font_size + half_stroke };
+    }
+
+    std::vector<svg::Polyline> MapRenderer::RenderRouteLines(const MapLayout& layout) const 
+    {
+        const SimplifiedRoutes simplified = IsSimplified() ? SimplifyRoutes(layout, 0) : SimplifiedRoutes{};
+
+        return RenderRouteLines(layout, simplified, 0, layout.routes.size());
+    }
+
+    std::vector<svg::Text> MapRenderer::RenderBusLabel(const MapLayout& layout) const 
+    {
+        return RenderBusLabel(layout, PlaceLabels(layout), 0, layout.routes.size());
+    }
+
+    std::vector<svg::Circle> MapRenderer::RenderStopPoints(const MapLayout& layout) const 
+    {
+        return RenderStopPoints(layout, 0, layout.stops.size());
+    }
+
+    std::vector<svg::Text> MapRenderer::RenderStopLabel(const MapLayout& layout) const 
+    {
+        return RenderStopLabel(layout, PlaceLabels(layout), 0, layout.stops.size());
+    }
+
+    std::vector<svg::Polyline> MapRenderer::RenderRouteLines(const MapLayout& layout, const SimplifiedRoutes& simplified, size_t begin, size_t end) const 
+    {
+        std::vector<svg::Polyline> lines;
+        lines.reserve(end - begin);
+
+        for (size_t i = begin; i < end; ++i) 
+        {
+            std::vector<size_t> path;
+
+            if (IsSimplified()) 
+            {
+                for (size_t position : simplified[i]) 
                 {
-                    svg::Text text_2 { text };
-                    svg::Text underlayer_2 { underlayer };
-
-                    text_2.SetPosition(sphere_projector(bus->stops.back()->coordinates));
-                    underlayer_2.SetPosition(sphere_projector(bus->stops.back()->coordinates));
-                    
-                    bus_labels.push_back(underlayer_2);
-                    bus_labels.push_back(text_2);
+                    path.push_back(layout.routes[i].stop_indices[position]);
                 }
+            }
+
+            else 
+            {
+                path = layout.routes[i].Path();
+            }
+
+            svg::Polyline line = MakeRouteLine(i);
+            line.ReservePoints(path.size());
+
+            for (size_t index : path) 
+            {
+                line.AddPoint(layout.points[index]);
+            }
+
+            lines.push_back(std::move(line));
+        }
+        
+        return lines;
+    }
+
+    std::vector<svg::Text> MapRenderer::RenderBusLabel(const MapLayout& layout, const LabelVisibility& labels, size_t begin, size_t end) const 
+    {
+        std::vector<svg::Text> bus_labels;
 
-                if (color < render_settings_.color_palette.size() - 1) 
+        // Маршруты без остановок в раскладку не попадают, и их названия не выводятся
+        for (size_t i = begin; i < end; ++i) 
+        {
+            const MapLayout::Route& route = layout.routes[i];
+            // Конечной считается первая остановка маршрута
+            if (labels.bus_labels[2 * i]) 
+            {
+                for (svg::Text& text : MakeBusLabel(*route.bus, layout.points[route.stop_indices.front()], i)) 
                 {
-                    ++color;
+                    bus_labels.push_back(std::move(text));
                 }
-                
-                else 
+            }
+            
+            // Название маршрута должно отрисовываться у каждой из его конечных остановок.
+            // В некольцевом маршруте — когда "is_roundtrip": false — конечной считается первая и последняя остановки маршрута
+            if (labels.bus_labels[2 * i + 1]) 
+            {
+                for (svg::Text& text : MakeBusLabel(*route.bus, layout.points[route.stop_indices.back()], i)) 
                 {
-                    color = 0;
+                    bus_labels.push_back(std::move(text));
                 }
             }
         }
@@ -139,108 +402,827 @@ namespace renderer
         return bus_labels;
     }
 
-    std::vector<svg::Circle> MapRenderer::RenderStopPoints(const std::map<std::string_view, const tc::Stop*>& stops, const SphereProjector& sphere_projector) const 
+    std::vector<svg::Circle> MapRenderer::RenderStopPoints(const MapLayout& layout, size_t begin, size_t end) const 
     {
-        // Каждая остановка маршрута изображается на карте в виде кружочков белого цвета
-        svg::Circle circle;
         std::vector<svg::Circle> circles;
+        circles.reserve(end - begin);
 
-        for (const auto &[stop_name, stop] : stops) 
+        for (size_t i = begin; i < end; ++i) 
         {    
-            // координаты центра cx и cy — координаты соответствующей остановки на карте
-            circle.SetCenter(sphere_projector(stop->coordinates));
-            // радиус r равен настройке stop_radius из словаря render_settings
-            circle.SetRadius(render_settings_.stop_radius);
-            // цвет заливки fill — "white"
-            circle.SetFillColor("white"s);
-
-            circles.push_back(circle);
+            circles.push_back(MakeStopPoint(layout.points[i]));
         }
 
         return circles;
     }
 
-    std::vector<svg::Text> MapRenderer::RenderStopLabel(const std::map<std::string_view, const tc::Stop*>& stops, const SphereProjector& sphere_projector) const 
+    std::vector<svg::Text> MapRenderer::RenderStopLabel(const MapLayout& layout, const LabelVisibility& labels, size_t begin, size_t end) const 
     {
         // Для каждой остановки выведите два текстовых объекта: подложку и саму надпись
-        svg::Text text;
-        svg::Text underlayer;
         std::vector<svg::Text> stop_labels;
+        stop_labels.reserve(2 * (end - begin));
 
-        for (const auto& [stop_name, stop] : stops) 
-        {
-            text.SetFillColor("black"s);
-            // x и y — координаты соответствующей остановки
-            text.SetPosition(sphere_projector(stop->coordinates));
-            // смещение dx и dy равно настройке stop_label_offset
-            text.SetOffset(render_settings_.stop_label_offset);
-            // размер шрифта font-size равен настройке stop_label_font_size
-            text.SetFontSize(render_settings_.stop_label_font_size);
-            // название шрифта font-family — "Verdana"
-            text.SetFontFamily("Verdana"s);
-            // свойства font-weight быть не должно, содержимое — название остановки
-            text.SetData(stop->name);
-            
-            // Дополнительные свойства подложки:
-            underlayer.SetPosition(sphere_projector(stop->coordinates));
-            underlayer.SetOffset(render_settings_.stop_label_offset);
-            underlayer.SetFontSize(render_settings_.stop_label_font_size);
-            underlayer.SetFontFamily("Verdana");
-            underlayer.SetData(stop->name);
-
-            // цвет заливки fill и цвет линий stroke равны настройке underlayer_color
-            underlayer.SetFillColor(render_settings_.underlayer_color);
-            underlayer.SetStrokeColor(render_settings_.underlayer_color);
-            // толщина линий stroke-width равна настройке underlayer_width
-            underlayer.SetStrokeWidth(render_settings_.underlayer_width);
-            // формы конца линии stroke-linecap и соединений stroke-linejoin равны "round"
-            underlayer.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
-            underlayer.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
-            
-            stop_labels.push_back(underlayer);
-            stop_labels.push_back(text);
+        for (size_t i = begin; i < end; ++i) 
+        {
+            if (!labels.stop_labels[i]) 
+            {
+                continue;
+            }
+
+            for (svg::Text& text : MakeStopLabel(*layout.stops[i], layout.points[i])) 
+            {
+                stop_labels.push_back(std::move(text));
+            }
         }
         
         return stop_labels;
     }
 
-    svg::Document MapRenderer::GetSVG(const std::map<std::string_view, const tc::Bus*>& buses) const 
+    MapRenderer::LabelVisibility MapRenderer::PlaceLabels(const MapLayout& layout) const 
     {
-        svg::Document document;
-        std::vector<geo::Coordinates> stop_coordinates;
-        std::map<std::string_view, const tc::Stop*> stops;
+        LabelVisibility labels;
+        labels.bus_labels.assign(2 * layout.routes.size(), true);
+        labels.stop_labels.assign(layout.stops.size(), true);
 
-        for (const auto& [bus_number, bus] : buses) 
+        // У кольцевого маршрута и маршрута с совпадающими конечными надпись одна
+        for (size_t i = 0; i < layout.routes.size(); ++i) 
         {
-            for (const auto& stop : bus->stops) 
+            const tc::Bus& bus = *layout.routes[i].bus;
+            labels.bus_labels[2 * i + 1] = !bus.is_roundtrip && bus.stops.front() != bus.stops.back();
+        }
+
+        if (!render_settings_.declutter_labels) 
+        {
+            return labels;
+        }
+
+        LabelPlacer placer({ 0.0, 0.0, render_settings_.width, render_settings_.height }, labels.bus_labels.size() + labels.stop_labels.size());
+        const auto try_place = [&placer](svg::Point anchor, const Rect& box) 
+        {
+            return placer.TryPlace({ anchor.x + box.min_x, anchor.y + box.min_y, anchor.x + box.max_x, anchor.y + box.max_y });
+        };
+
+        for (size_t i = 0; i < layout.routes.size(); ++i) 
+        {
+            const MapLayout::Route& route = layout.routes[i];
+            const Rect box = EstimateLabelFootprint(route.bus->number, render_settings_.bus_label_offset, render_settings_.bus_label_font_size);
+            labels.bus_labels[2 * i] = try_place(layout.points[route.stop_indices.front()], box);
+
+            if (labels.bus_labels[2 * i + 1]) 
             {
-                stop_coordinates.push_back(stop->coordinates);
-                stops[stop->name] = stop;
+                labels.bus_labels[2 * i + 1] = try_place(layout.points[route.stop_indices.back()], box);
             }
         }
 
-        SphereProjector sphere_projector(stop_coordinates.begin(), stop_coordinates.end(), render_settings_.width, render_settings_.height, render_settings_.padding);
-        
-        for (const auto& line : RenderRouteLines(buses, sphere_projector))
+        for (size_t i : GetStopLabelOrder(layout)) 
+        {
+            const Rect box = EstimateLabelFootprint(layout.stops[i]->name, render_settings_.stop_label_offset, render_settings_.stop_label_font_size);
+            labels.stop_labels[i] = try_place(layout.points[i], box);
+        }
+
+        return labels;
+    }
+
+    std::vector<size_t> MapRenderer::GetStopLabelOrder(const MapLayout& layout) const 
+    {
+        std::vector<bool> is_terminal(layout.stops.size(), false);
+
+        for (const MapLayout::Route& route : layout.routes) 
+        {
+            is_terminal[route.stop_indices.front()] = true;
+
+            if (!route.bus->is_roundtrip) 
+            {
+                is_terminal[route.stop_indices.back()] = true;
+            }
+        }
+
+        std::vector<size_t> order;
+        order.reserve(layout.stops.size());
+
+        for (bool terminals : { true, false }) 
+        {
+            for (size_t i = 0; i < layout.stops.size(); ++i) 
+            {
+                if (is_terminal[i] == terminals) 
+                {
+                    order.push_back(i);
+                }
+            }
+        }
+
+        return order;
+    }
+
+    svg::Document MapRenderer::GetSVG(const std::map<std::string_view, const tc::Bus*>& buses) const 
+    {
+        return GetSVG(BuildLayout(buses));
+    }
+
+    svg::Document MapRenderer::GetSVG(const MapLayout& layout) const 
+    {
+        const LabelVisibility labels = PlaceLabels(layout);
+        std::vector<svg::Polyline> lines = RenderRouteLines(layout);
+        std::vector<svg::Text> bus_labels = RenderBusLabel(layout, labels, 0, layout.routes.size());
+        std::vector<svg::Circle> circles = RenderStopPoints(layout);
+        std::vector<svg::Text> stop_labels = RenderStopLabel(layout, labels, 0, layout.stops.size());
+        svg::Document document;
+        document.Reserve(lines.size() + bus_labels.size() + circles.size() + stop_labels.size() + 1);
+        AddStyleSheet(document);
+
+        // Объекты переносятся в документ без копирования точек ломаных и строк надписей
+        for (auto& line : lines)
         { 
-            document.Add(line);
+            document.Add(std::move(line));
         }
         
-        for (const auto& text : RenderBusLabel(buses, sphere_projector)) 
+        for (auto& text : bus_labels) 
         {
-            document.Add(text);
+            document.Add(std::move(text));
         }
         
-        for (const auto& circle : RenderStopPoints(stops, sphere_projector)) 
+        for (auto& circle : circles) 
         {
-            document.Add(circle);
+            document.Add(std::move(circle));
         }
         
-        for (const auto& text : RenderStopLabel(stops, sphere_projector)) 
+        for (auto& text : stop_labels) 
         {
-            document.Add(text);
+            document.Add(std::move(text));
         }
 
         return document;
     }
+
+    void MapRenderer::RenderMap(const MapLayout& layout, std::string& out) const 
+    {
+        const SimplifiedRoutes simplified = IsSimplified() ? SimplifyRoutes(layout, 0) : SimplifiedRoutes{};
+        // Раскладка надписей последовательна: каждая надпись проверяется по уже принятым
+        const LabelVisibility labels = PlaceLabels(layout);
+        const size_t thread_count = parallel::GetThreadCount();
+
+        // Каждый слой делится примерно на thread_count частей, но не мельче MIN_LAYER_CHUNK маршрутов или остановок
+        std::vector<LayerChunk> chunks;
+        const auto split_layer = [&chunks, thread_count](Layer layer, size_t count) 
+        {
+            const size_t chunk_size = std::max(MIN_LAYER_CHUNK, (count + thread_count - 1) / thread_count);
+
+            for (size_t begin = 0; begin < count; begin += chunk_size) 
+            {
+                chunks.push_back({ layer, begin, std::min(count, begin + chunk_size) });
+            }
+        };
+
+        split_layer(Layer::ROUTE_LINES, layout.routes.size());
+        split_layer(Layer::BUS_LABELS, layout.routes.size());
+        split_layer(Layer::STOP_POINTS, layout.stops.size());
+        split_layer(Layer::STOP_LABELS, layout.stops.size());
+
+        svg::Document::RenderHeader(out);
+        svg::Document style;
+        AddStyleSheet(style);
+        style.RenderObjects(out);
+
+        // Одновременно отрисовывается не больше thread_count частей; готовые части дописываются в out по порядку слоёв
+        parallel::RunOrdered(chunks.size(), thread_count, [this, &layout, &simplified, &labels, &chunks](size_t chunk) 
+        {
+            return RenderLayerChunk(layout, simplified, labels, chunks[chunk]);
+        }, [&out](const std::string& part) 
+        {
+            out += part;
+        });
+
+        svg::Document::RenderFooter(out);
+    }
+
+    std::string MapRenderer::RenderLayerChunk(const MapLayout& layout, const SimplifiedRoutes& simplified, const LabelVisibility& labels, 
+                                              const LayerChunk& chunk) const 
+    {
+        svg::Document document;
+
+        switch (chunk.layer) 
+        {
+        case Layer::ROUTE_LINES:
+            for (auto& line : RenderRouteLines(layout, simplified, chunk.begin, chunk.end)) 
+            {
+                document.Add(std::move(line));
+            }
+            break;
+
+        case Layer::BUS_LABELS:
+            for (auto& text : RenderBusLabel(layout, labels, chunk.begin, chunk.end)) 
+            {
+                document.Add(std::move(text));
+            }
+            break;
+
+        case Layer::STOP_POINTS:
+            for (auto& circle : RenderStopPoints(layout, chunk.begin, chunk.end)) 
+            {
+                document.Add(std::move(circle));
+            }
+            break;
+
+        case Layer::STOP_LABELS:
+            for (auto& text : RenderStopLabel(layout, labels, chunk.begin, chunk.end)) 
+            {
+                document.Add(std::move(text));
+            }
+            break;
+        }
+
+        std::string bytes;
+        document.RenderObjects(bytes);
+
+        return bytes;
+    }
+
+    const std::string& MapRenderer::GetMapSvg(const BusesProvider& get_buses) const 
+    {
+        return RenderCached(get_buses).svg;
+    }
+
+    const std::string& MapRenderer::GetMapJson(const BusesProvider& get_buses) const 
+    {
+        return RenderCached(get_buses).json;
+    }
+
+    const MapLayout& MapRenderer::GetLayout(const BusesProvider& get_buses) const 
+    {
+        std::call_once(map_cache_->laid_out, [this, &get_buses]() 
+        {
+            map_cache_->layout = BuildLayout(get_buses());
+        });
+
+        return map_cache_->layout;
+    }
+
+    bool MapRenderer::IsValidTile(int z, int x, int y) 
+    {
+        if (z < 0 || z > MAX_TILE_ZOOM) 
+        {
+            return false;
+        }
+
+        const int tile_count = 1 << z;
+
+        return 0 <= x && x < tile_count && 0 <= y && y < tile_count;
+    }
+
+    svg::Document MapRenderer::RenderTile(const BusesProvider& get_buses, int z, int x, int y) const 
+    {
+        if (!IsValidTile(z, x, y)) 
+        {
+            throw std::out_of_range("wrong map tile"s);
+        }
+
+        const MapLayout& layout = GetLayout(get_buses);
+        const TileIndex& index = GetTileIndex(get_buses);
+
+        // Во сколько раз фрагмент увеличивается при выводе
+        const double scale = static_cast<double>(1 << z);
+        const double tile_width = render_settings_.width / scale;
+        const double tile_height = render_settings_.height / scale;
+        const svg::Point origin{ x * tile_width, y * tile_height };
+
+        Region region;
+        region.area = { origin.x, origin.y, origin.x + tile_width, origin.y + tile_height };
+        region.pixel_size = 1.0 / scale;
+        region.width = render_settings_.width;
+        region.height = render_settings_.height;
+        region.project = [&layout, origin, scale](size_t stop) 
+        {
+            const svg::Point point = layout.points[stop];
+            return svg::Point{ (point.x - origin.x) * scale, (point.y - origin.y) * scale };
+        };
+        region.level = z;
+
+        return RenderRegion(layout, index, region);
+    }
+
+    bool MapRenderer::IsValidViewport(const Viewport& viewport) 
+    {
+        return viewport.min.lat < viewport.max.lat && viewport.min.lng < viewport.max.lng 
+            && viewport.width > 0.0 && viewport.height > 0.0;
+    }
+
+    svg::Document MapRenderer::RenderViewport(const BusesProvider& get_buses, const Viewport& viewport) const 
+    {
+        if (!IsValidViewport(viewport)) 
+        {
+            throw std::invalid_argument("wrong viewport"s);
+        }
+
+        const MapLayout& layout = GetLayout(get_buses);
+        const TileIndex& index = GetTileIndex(get_buses);
+
+        const geo::Coordinates corners[] = { viewport.min, viewport.max };
+        const SphereProjector projector(std::begin(corners), std::end(corners), viewport.width, viewport.height, 0.0);
+        const SphereProjector& map_projector = *layout.projector;
+
+        // Левый верхний угол изображения на полной карте; масштабы обеих проекций линейны по широте и долготе
+        const svg::Point origin = map_projector({ viewport.max.lat, viewport.min.lng });
+
+        Region region;
+        region.pixel_size = map_projector.GetZoomCoeff() / projector.GetZoomCoeff();
+        region.area = { origin.x, origin.y, origin.x + viewport.width * region.pixel_size, origin.y + viewport.height * region.pixel_size };
+        region.width = viewport.width;
+        region.height = viewport.height;
+        region.project = [&layout, &projector](size_t stop) 
+        {
+            return projector(layout.stops[stop]->coordinates);
+        };
+        // Ближайший уровень детализации, не грубее масштаба окна
+        region.level = region.pixel_size > 0.0 
+            ? std::clamp(static_cast<int>(std::ceil(-std::log2(region.pixel_size))), 0, MAX_TILE_ZOOM) 
+            : MAX_TILE_ZOOM;
+
+        return RenderRegion(layout, index, region);
+    }
+
+    std::string MapRenderer::GetViewportJson(const BusesProvider& get_buses, const Viewport& viewport) const 
+    {
+        std::string svg;
+        RenderViewport(get_buses, viewport).Render(svg);
+
+        return json::EscapeString(svg);
+    }
+
+    svg::Document MapRenderer::RenderRouteOverlay(const BusesProvider& get_buses, const std::vector<RouteLeg>& legs) const 
+    {
+        const MapLayout& layout = GetLayout(get_buses);
+        svg::Document document;
+
+        if (legs.empty()) 
+        {
+            return document;
+        }
+
+        // Цвет поездки совпадает с цветом её маршрута на карте; маршруты раскладки упорядочены по номерам
+        const auto get_color = [this, &layout](const tc::Bus* bus) 
+        {
+            const auto it = std::lower_bound(layout.routes.begin(), layout.routes.end(), bus->number, 
+                [](const MapLayout::Route& route, const std::string& number) 
+                {
+                    return route.bus->number < number;
+                });
+            const size_t route_index = static_cast<size_t>(it - layout.routes.begin());
+
+            return render_settings_.color_palette[GetPaletteIndex(route_index)];
+        };
+
+        const auto make_line = [this, &layout](const RouteLeg& leg) 
+        {
+            svg::Polyline line;
+            line.ReservePoints(leg.stops.size());
+
+            for (const tc::Stop* stop : leg.stops) 
+            {
+                line.AddPoint(layout.points[layout.stop_index.at(stop)]);
+            }
+
+            if (render_settings_.compact_svg) 
+            {
+                line.SetPathEncoding(render_settings_.svg_precision);
+            }
+
+            line.SetFillColor("none"s).SetStrokeLineCap(svg::StrokeLineCap::ROUND).SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+
+            return line;
+        };
+
+        const auto make_marker = [this, &layout](const tc::Stop* stop, const svg::Color& color) 
+        {
+            const svg::Point position = layout.points[layout.stop_index.at(stop)];
+            svg::Circle circle;
+            circle.SetCenter(render_settings_.compact_svg ? RoundPoint(position) : position)
+                  .SetRadius(2 * render_settings_.stop_radius);
+            circle.SetFillColor("white"s).SetStrokeColor(color).SetStrokeWidth(render_settings_.stop_radius);
+
+            return circle;
+        };
+
+        document.Reserve(3 * legs.size() + 1);
+
+        // Подложки рисуются под всеми линиями, чтобы пересадка не перекрывала предыдущую поездку
+        for (const RouteLeg& leg : legs) 
+        {
+            svg::Polyline halo = make_line(leg);
+            halo.SetStrokeColor(render_settings_.underlayer_color)
+                .SetStrokeWidth(render_settings_.line_width + 2 * render_settings_.underlayer_width);
+            document.Add(std::move(halo));
+        }
+
+        for (const RouteLeg& leg : legs) 
+        {
+            svg::Polyline line = make_line(leg);
+            line.SetStrokeColor(get_color(leg.bus)).SetStrokeWidth(render_settings_.line_width);
+            document.Add(std::move(line));
+        }
+
+        // Кружки посадки и пересадок, затем конечная остановка маршрута
+        for (const RouteLeg& leg : legs) 
+        {
+            document.Add(make_marker(leg.stops.front(), get_color(leg.bus)));
+        }
+
+        document.Add(make_marker(legs.back().stops.back(), get_color(legs.back().bus)));
+
+        return document;
+    }
+
+    svg::Document MapRenderer::RenderIsochroneOverlay(const BusesProvider& get_buses, const std::vector<IsochroneStop>& stops) const 
+    {
+        const MapLayout& layout = GetLayout(get_buses);
+        svg::Document document;
+        document.Reserve(stops.size());
+
+        for (auto it = stops.rbegin(); it != stops.rend(); ++it) 
+        {
+            const auto index = layout.stop_index.find(it->stop);
+
+            if (index == layout.stop_index.end()) 
+            {
+                continue;
+            }
+
+            const svg::Point position = layout.points[index->second];
+            svg::Circle circle;
+            circle.SetCenter(render_settings_.compact_svg ? RoundPoint(position) : position)
+                  .SetRadius(2 * render_settings_.stop_radius);
+            circle.SetFillColor(render_settings_.color_palette[GetPaletteIndex(it->band)])
+                  .SetStrokeColor(render_settings_.underlayer_color)
+                  .SetStrokeWidth(render_settings_.underlayer_width);
+            document.Add(std::move(circle));
+        }
+
+        return document;
+    }
+
+    svg::Document MapRenderer::RenderRegion(const MapLayout& layout, const TileIndex& index, const Region& region) const 
+    {
+        const Rect visible{ 0.0, 0.0, region.width, region.height };
+        svg::Document document;
+        AddStyleSheet(document);
+
+        RenderClippedLines(layout, index, region, document);
+
+        const double bus_label_margin = index.bus_label_reach * region.pixel_size;
+        const std::vector<uint32_t> bus_labels = index.bus_label_index.Query(region.area.Expanded(bus_label_margin));
+        const double stop_margin = std::max(render_settings_.stop_radius, index.stop_label_reach) * region.pixel_size;
+        const std::vector<uint32_t> stops = index.stop_index.Query(region.area.Expanded(stop_margin));
+
+        // Наложения ищутся среди надписей изображения: размер надписей не зависит от масштаба
+        std::optional<LabelPlacer> placer;
+
+        if (render_settings_.declutter_labels) 
+        {
+            placer.emplace(visible, bus_labels.size() + stops.size());
+        }
+
+        const auto try_place = [&placer](svg::Point anchor, const Rect& box) 
+        {
+            return !placer || placer->TryPlace({ anchor.x + box.min_x, anchor.y + box.min_y, anchor.x + box.max_x, anchor.y + box.max_y });
+        };
+
+        for (uint32_t id : bus_labels) 
+        {
+            const TileIndex::BusLabel& label = index.bus_labels[id];
+            const tc::Bus& bus = *layout.routes[label.route].bus;
+            const svg::Point anchor = region.project(label.stop);
+            const Rect box = EstimateLabelBox(bus.number, render_settings_.bus_label_offset, render_settings_.bus_label_font_size);
+
+            if (Rect{ anchor.x + box.min_x, anchor.y + box.min_y, anchor.x + box.max_x, anchor.y + box.max_y }.Intersects(visible)
+                && try_place(anchor, EstimateLabelFootprint(bus.number, render_settings_.bus_label_offset, render_settings_.bus_label_font_size))) 
+            {
+                for (svg::Text& text : MakeBusLabel(bus, anchor, label.route)) 
+                {
+                    document.Add(std::move(text));
+                }
+            }
+        }
+
+        std::vector<svg::Point> anchors;
+        anchors.reserve(stops.size());
+
+        for (uint32_t id : stops) 
+        {
+            anchors.push_back(region.project(id));
+
+            if (Rect::Bounding(anchors.back(), anchors.back()).Expanded(render_settings_.stop_radius).Intersects(visible)) 
+            {
+                document.Add(MakeStopPoint(anchors.back()));
+            }
+        }
+
+        // Номера в stops видимых надписей остановок
+        std::vector<size_t> stop_labels;
+
+        for (size_t i = 0; i < stops.size(); ++i) 
+        {
+            const Rect box = EstimateLabelBox(layout.stops[stops[i]]->name, render_settings_.stop_label_offset, render_settings_.stop_label_font_size);
+
+            if (Rect{ anchors[i].x + box.min_x, anchors[i].y + box.min_y, anchors[i].x + box.max_x, anchors[i].y + box.max_y }.Intersects(visible)) 
+            {
+                stop_labels.push_back(i);
+            }
+        }
+
+        if (placer) 
+        {
+            // Надписи раскладываются в порядке полной карты, а выводятся по алфавиту
+            std::vector<size_t> order = stop_labels;
+            std::sort(order.begin(), order.end(), [&index, &stops](size_t lhs, size_t rhs) 
+            {
+                return index.stop_label_ranks[stops[lhs]] < index.stop_label_ranks[stops[rhs]];
+            });
+
+            std::vector<bool> placed(stops.size(), false);
+
+            for (size_t i : order) 
+            {
+                const Rect box = EstimateLabelFootprint(layout.stops[stops[i]]->name, render_settings_.stop_label_offset, render_settings_.stop_label_font_size);
+                placed[i] = try_place(anchors[i], box);
+            }
+
+            stop_labels.erase(std::remove_if(stop_labels.begin(), stop_labels.end(), [&placed](size_t i) 
+            {
+                return !placed[i];
+            }), stop_labels.end());
+        }
+
+        for (size_t i : stop_labels) 
+        {
+            for (svg::Text& text : MakeStopLabel(*layout.stops[stops[i]], anchors[i])) 
+            {
+                document.Add(std::move(text));
+            }
+        }
+
+        return document;
+    }
+
+    void MapRenderer::RenderClippedLines(const MapLayout& layout, const TileIndex& index, const Region& region, svg::Document& document) const 
+    {
+        // Отсечение идёт с запасом в половину толщины линии, чтобы концы отрезков не были видны на краю изображения
+        const double half_width = render_settings_.line_width / 2;
+        const Rect clip_area = Rect{ 0.0, 0.0, region.width, region.height }.Expanded(half_width);
+        // Упрощённая ломаная отклоняется от исходной не больше чем на допуск
+        const double query_margin = (half_width + render_settings_.simplify_tolerance) * region.pixel_size;
+        const std::vector<uint32_t> candidates = index.segment_index.Query(region.area.Expanded(query_margin));
+
+        // Отрезок выводимой ломаной маршрута: без упрощения — отрезок ломаной из TileIndex::paths,
+        // с упрощением — отрезок между соседними оставшимися остановками
+        struct Piece 
+        {
+            uint32_t route = 0;
+            size_t segment = 0;
+        };
+
+        std::vector<Piece> pieces;
+        pieces.reserve(candidates.size());
+        const SimplifiedRoutes* simplified = IsSimplified() ? &GetSimplifiedRoutes(layout, region.level) : nullptr;
+
+        for (uint32_t id : candidates) 
+        {
+            const TileIndex::Segment& segment = index.segments[id];
+
+            if (!simplified) 
+            {
+                pieces.push_back({ segment.route, segment.position });
+                continue;
+            }
+
+            // Отрезок обратного хода совпадает с отрезком прямого хода
+            const size_t forward_segments = layout.routes[segment.route].stop_indices.size() - 1;
+            const size_t position = segment.position < forward_segments ? segment.position : 2 * forward_segments - 1 - segment.position;
+            const auto& kept = (*simplified)[segment.route];
+            const size_t piece = std::upper_bound(kept.begin(), kept.end(), position) - kept.begin() - 1;
+            pieces.push_back({ segment.route, piece });
+        }
+
+        if (simplified) 
+        {
+            std::sort(pieces.begin(), pieces.end(), [](const Piece& lhs, const Piece& rhs) 
+            {
+                return std::tie(lhs.route, lhs.segment) < std::tie(rhs.route, rhs.segment);
+            });
+            pieces.erase(std::unique(pieces.begin(), pieces.end(), [](const Piece& lhs, const Piece& rhs) 
+            {
+                return lhs.route == rhs.route && lhs.segment == rhs.segment;
+            }), pieces.end());
+        }
+
+        // Номер остановки в раскладке для вершины vertex выводимой ломаной маршрута
+        const auto stop_of = [&layout, &index, simplified](uint32_t route, size_t vertex) 
+        {
+            if (simplified) 
+            {
+                return layout.routes[route].stop_indices[(*simplified)[route][vertex]];
+            }
+
+            return index.paths[route][vertex];
+        };
+
+        svg::Polyline line;
+        bool line_open = false;
+        Piece previous;
+
+        const auto close_line = [&document, &line, &line_open]() 
+        {
+            if (line_open) 
+            {
+                document.Add(std::move(line));
+                line_open = false;
+            }
+        };
+
+        for (const Piece& piece : pieces) 
+        {
+            svg::Point from = region.project(stop_of(piece.route, piece.segment));
+            svg::Point to = region.project(stop_of(piece.route, piece.segment + 1));
+            const bool from_visible = clip_area.Contains(from);
+            const bool to_visible = clip_area.Contains(to);
+
+            if (!ClipSegment(clip_area, from, to)) 
+            {
+                close_line();
+                continue;
+            }
+
+            // Ломаная продолжается, если отрезок следует за предыдущим в том же маршруте и их общая точка видна
+            const bool continues = line_open && from_visible && piece.route == previous.route && piece.segment == previous.segment + 1;
+
+            if (!continues) 
+            {
+                close_line();
+                line = MakeRouteLine(piece.route);
+                line.AddPoint(from);
+                line_open = true;
+            }
+
+            line.AddPoint(to);
+            previous = piece;
+
+            if (!to_visible) 
+            {
+                close_line();
+            }
+        }
+
+        close_line();
+    }
+
+    bool MapRenderer::IsSimplified() const 
+    {
+        return render_settings_.simplify_tolerance > 0.0;
+    }
+
+    MapRenderer::SimplifiedRoutes MapRenderer::SimplifyRoutes(const MapLayout& layout, int level) const 
+    {
+        const double tolerance = std::ldexp(render_settings_.simplify_tolerance, -level);
+        SimplifiedRoutes simplified;
+        simplified.reserve(layout.routes.size());
+        std::vector<svg::Point> points;
+
+        for (const MapLayout::Route& route : layout.routes) 
+        {
+            points.clear();
+
+            for (size_t stop : route.stop_indices) 
+            {
+                points.push_back(layout.points[stop]);
+            }
+
+            simplified.push_back(SimplifyPolyline(points, tolerance));
+        }
+
+        return simplified;
+    }
+
+    const MapRenderer::SimplifiedRoutes& MapRenderer::GetSimplifiedRoutes(const MapLayout& layout, int level) const 
+    {
+        std::call_once(map_cache_->simplified_flags[level], [this, &layout, level]() 
+        {
+            map_cache_->simplified[level] = SimplifyRoutes(layout, level);
+        });
+
+        return map_cache_->simplified[level];
+    }
+
+    std::shared_ptr<const std::string> MapRenderer::GetTileJson(const BusesProvider& get_buses, int z, int x, int y) const 
+    {
+        const uint64_t key = (static_cast<uint64_t>(z) << 48) | (static_cast<uint64_t>(x) << 24) | static_cast<uint64_t>(y);
+
+        if (auto cached = map_cache_->tiles.Get(key)) 
+        {
+            return *cached;
+        }
+
+        std::string svg;
+        RenderTile(get_buses, z, x, y).Render(svg);
+        auto tile = std::make_shared<const std::string>(json::EscapeString(svg));
+        map_cache_->tiles.Put(key, tile);
+
+        return tile;
+    }
+
+    std::unique_ptr<MapRenderer::TileIndex> MapRenderer::BuildTileIndex(const MapLayout& layout) const 
+    {
+        std::vector<std::vector<size_t>> paths;
+        std::vector<TileIndex::Segment> segments;
+        std::vector<TileIndex::BusLabel> bus_labels;
+        paths.reserve(layout.routes.size());
+
+        for (size_t i = 0; i < layout.routes.size(); ++i) 
+        {
+            const MapLayout::Route& route = layout.routes[i];
+            paths.push_back(route.Path());
+
+            for (size_t position = 0; position + 1 < paths.back().size(); ++position) 
+            {
+                segments.push_back({ static_cast<uint32_t>(i), static_cast<uint32_t>(position) });
+            }
+
+            // Надписи у конечных остановок — в том же порядке, что и в RenderBusLabel
+            bus_labels.push_back({ static_cast<uint32_t>(i), route.stop_indices.front() });
+
+            if (!route.bus->is_roundtrip && route.bus->stops.front() != route.bus->stops.back()) 
+            {
+                bus_labels.push_back({ static_cast<uint32_t>(i), route.stop_indices.back() });
+            }
+        }
+
+        const Rect bounds{ 0.0, 0.0, render_settings_.width, render_settings_.height };
+        SpatialIndex segment_index(bounds, segments.size());
+
+        for (size_t id = 0; id < segments.size(); ++id) 
+        {
+            const auto& path = paths[segments[id].route];
+            const size_t position = segments[id].position;
+            segment_index.InsertSegment(layout.points[path[position]], layout.points[path[position + 1]], static_cast<uint32_t>(id));
+        }
+
+        // Размер надписей на фрагменте не зависит от масштаба, поэтому в индексе хранятся только точки привязки,
+        // а область запроса расширяется на наибольший размер надписи
+        const auto reach = [](const Rect& box) 
+        {
+            return std::max({ std::abs(box.min_x), std::abs(box.min_y), std::abs(box.max_x), std::abs(box.max_y) });
+        };
+
+        SpatialIndex bus_label_index(bounds, bus_labels.size());
+        double bus_label_reach = 0.0;
+
+        for (size_t id = 0; id < bus_labels.size(); ++id) 
+        {
+            const svg::Point anchor = layout.points[bus_labels[id].stop];
+            bus_label_index.Insert(Rect::Bounding(anchor, anchor), static_cast<uint32_t>(id));
+            const std::string& number = layout.routes[bus_labels[id].route].bus->number;
+            bus_label_reach = std::max(bus_label_reach, 
+                reach(EstimateLabelBox(number, render_settings_.bus_label_offset, render_settings_.bus_label_font_size)));
+        }
+
+        SpatialIndex stop_index(bounds, layout.points.size());
+        double stop_label_reach = 0.0;
+
+        for (size_t id = 0; id < layout.points.size(); ++id) 
+        {
+            const svg::Point point = layout.points[id];
+            stop_index.Insert(Rect::Bounding(point, point), static_cast<uint32_t>(id));
+            stop_label_reach = std::max(stop_label_reach, 
+                reach(EstimateLabelBox(layout.stops[id]->name, render_settings_.stop_label_offset, render_settings_.stop_label_font_size)));
+        }
+
+        std::vector<uint32_t> stop_label_ranks(layout.stops.size());
+        const std::vector<size_t> stop_label_order = GetStopLabelOrder(layout);
+
+        for (size_t rank = 0; rank < stop_label_order.size(); ++rank) 
+        {
+            stop_label_ranks[stop_label_order[rank]] = static_cast<uint32_t>(rank);
+        }
+
+        return std::make_unique<TileIndex>(TileIndex{ std::move(paths), std::move(segments), std::move(bus_labels), 
+            std::move(segment_index), std::move(stop_index), std::move(bus_label_index), bus_label_reach, stop_label_reach, 
+            std::move(stop_label_ranks) });
+    }
+
+    const MapRenderer::TileIndex& MapRenderer::GetTileIndex(const BusesProvider& get_buses) const 
+    {
+        std::call_once(map_cache_->indexed, [this, &get_buses]() 
+        {
+            map_cache_->tile_index = BuildTileIndex(GetLayout(get_buses));
+        });
+
+        return *map_cache_->tile_index;
+    }
+
+    const MapRenderer::MapCache& MapRenderer::RenderCached(const BusesProvider& get_buses) const 
+    {
+        std::call_once(map_cache_->rendered, [this, &get_buses]() 
+        {
+            RenderMap(GetLayout(get_buses), map_cache_->svg);
+            map_cache_->json = json::EscapeString(map_cache_->svg);
+        });
+
+        return *map_cache_;
+    }
 } // end namespace renderer
\ No newline at end of file
@@ -1,10 +1,22 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include "domain.h"
 #include "geo.h"
 #include "json.h"
+#include "lru_cache.h"
+#include "polyline_simplifier.h"
+#include "spatial_index.h"
 #include "svg.h"
 
 namespace renderer 
@@ -73,6 +85,12 @@ namespace renderer
                          (max_lat_ - coords.lat) * zoom_coeff_ + padding_ };
             }
 
+            // Число пикселей на градус широты и долготы
+            double GetZoomCoeff() const 
+            {
+                return zoom_coeff_;
+            }
+
         private:
         
             double padding_;
@@ -112,25 +130,299 @@ namespace renderer
         double underlayer_width = 0.0;
         // цветовая палитра
         std::vector<svg::Color> color_palette {};
+        // число отрисованных фрагментов карты (MapTile), которые хранятся в кэше. Необязательная настройка
+        size_t tile_cache_size = 256;
+        // допуск упрощения ломаных маршрутов в пикселях изображения. Необязательная настройка; 0 — без упрощения.
+        // При упрощении обратный ход некольцевого маршрута не выводится: он проходит по тем же точкам
+        double simplify_tolerance = 0.0;
+        // компактный SVG: ломаные выводятся элементами <path> с относительными координатами, 
+        // а повторяющееся оформление — таблицей стилей с классами. Необязательная настройка
+        bool compact_svg = false;
+        // число знаков после запятой в координатах <path> компактного SVG. Целое число от 0 до 9
+        int svg_precision = 2;
+        // удалять надписи, которые наложились бы на уже выведенные. Необязательная настройка.
+        // Сначала раскладываются названия маршрутов, затем названия конечных остановок и остальных остановок
+        bool declutter_labels = false;
+    };
+
+    /*
+    * Раскладка карты: экранные координаты каждой остановки, через которую проходят маршруты, 
+    * вычисляются один раз и используются линиями маршрутов, надписями и кружками остановок
+    */
+    struct MapLayout 
+    {
+        // Маршрут с непустым списком остановок
+        struct Route 
+        {
+            const tc::Bus* bus = nullptr;
+            // Номера остановок маршрута в массивах stops и points (без обратного хода некольцевого маршрута)
+            std::vector<size_t> stop_indices;
+
+            // Номера точек ломаной маршрута; у некольцевого маршрута к ним добавлен обратный ход
+            std::vector<size_t> Path() const;
+        };
+
+        // Маршруты в алфавитном порядке номеров
+        std::vector<Route> routes;
+        // Остановки маршрутов в алфавитном порядке названий, каждая по одному разу
+        std::vector<const tc::Stop*> stops;
+        // Экранные координаты остановок: points[i] соответствует stops[i]
+        std::vector<svg::Point> points;
+        // Номер остановки в массивах stops и points
+        std::unordered_map<const tc::Stop*, size_t> stop_index;
+        // Проекция, которой получены points
+        std::optional<SphereProjector> projector;
+    };
+
+    // Окно просмотра: прямоугольник на поверхности Земли и размеры изображения в пикселях
+    struct Viewport 
+    {
+        geo::Coordinates min = { 0.0, 0.0 };
+        geo::Coordinates max = { 0.0, 0.0 };
+        double width = 0.0;
+        double height = 0.0;
+    };
+
+    // Остановка изохроны: band — номер интервала времени в пути, в который до неё можно доехать
+    struct IsochroneStop 
+    {
+        const tc::Stop* stop = nullptr;
+        size_t band = 0;
+    };
+
+    // Поездка найденного маршрута: автобус bus проезжает остановки stops по порядку
+    struct RouteLeg 
+    {
+        const tc::Bus* bus = nullptr;
+        std::vector<const tc::Stop*> stops;
     };
 
     class MapRenderer 
     {
         public:
 
+            // Источник списка маршрутов: вызывается только при первом построении карты
+            using BusesProvider = std::function<std::map<std::string_view, const tc::Bus*>()>;
+
             MapRenderer(const RenderSettings& render_settings)
                 : render_settings_(render_settings)
+                , map_cache_(std::make_unique<MapCache>(render_settings.tile_cache_size))
                 {}
+
+            // Наибольший поддерживаемый уровень масштаба фрагментов карты
+            static constexpr int MAX_TILE_ZOOM = 20;
+
+            const RenderSettings& GetRenderSettings() const 
+            {
+                return render_settings_;
+            }
     
-        std::vector<svg::Polyline> RenderRouteLines(const std::map<std::string_view, const tc::Bus*>& buses, const SphereProjector& sp) const;
-        std::vector<svg::Text> RenderBusLabel(const std::map<std::string_view, const tc::Bus*>& buses, const SphereProjector& sp) const;
-        std::vector<svg::Circle> RenderStopPoints(const std::map<std::string_view, const tc::Stop*>& stops, const SphereProjector& sp) const;
-        std::vector<svg::Text> RenderStopLabel(const std::map<std::string_view, const tc::Stop*>& stops, const SphereProjector& sp) const;
+        // Проецирует каждую остановку маршрутов на карту ровно один раз
+        MapLayout BuildLayout(const std::map<std::string_view, const tc::Bus*>& buses) const;
+
+        std::vector<svg::Polyline> RenderRouteLines(const MapLayout& layout) const;
+        std::vector<svg::Text> RenderBusLabel(const MapLayout& layout) const;
+        std::vector<svg::Circle> RenderStopPoints(const MapLayout& layout) const;
+        std::vector<svg::Text> RenderStopLabel(const MapLayout& layout) const;
         
         svg::Document GetSVG(const std::map<std::string_view, const tc::Bus*>& buses) const;
+        svg::Document GetSVG(const MapLayout& layout) const;
+        // Раскладка карты строится один раз и переиспользуется всеми последующими отрисовками
+        const MapLayout& GetLayout(const BusesProvider& get_buses) const;
+        // Справочник и настройки после загрузки не меняются, поэтому карта рисуется один раз, 
+        // а повторные вызовы возвращают сохранённый SVG-документ
+        const std::string& GetMapSvg(const BusesProvider& get_buses) const;
+        // Та же карта в виде готовой JSON-строки: в кавычках и с экранированием
+        const std::string& GetMapJson(const BusesProvider& get_buses) const;
+
+        // Проверяет, что фрагмент z/x/y существует: 0 <= z <= MAX_TILE_ZOOM, 0 <= x, y < 2^z
+        static bool IsValidTile(int z, int x, int y);
+        /*
+        * Отрисовывает фрагмент карты в схеме z/x/y: на уровне z изображение делится на 2^z x 2^z фрагментов,
+        * фрагмент (x, y) растягивается до размеров всей карты. Толщина линий, радиусы и шрифты не масштабируются.
+        * Через пространственный индекс перебираются только отрезки маршрутов, остановки и надписи, задевающие фрагмент
+        */
+        svg::Document RenderTile(const BusesProvider& get_buses, int z, int x, int y) const;
+        // Фрагмент карты в виде JSON-строки; недавно запрошенные фрагменты берутся из кэша
+        std::shared_ptr<const std::string> GetTileJson(const BusesProvider& get_buses, int z, int x, int y) const;
+
+        // Проверяет, что у окна просмотра ненулевая площадь и размеры изображения
+        static bool IsValidViewport(const Viewport& viewport);
+        /*
+        * Отрисовывает окно просмотра: прямоугольник вписывается в изображение width x height без отступов.
+        * Ломаные маршрутов отсекаются по границе изображения, остановки и надписи за его пределами пропускаются
+        */
+        svg::Document RenderViewport(const BusesProvider& get_buses, const Viewport& viewport) const;
+        // Окно просмотра в виде JSON-строки
+        std::string GetViewportJson(const BusesProvider& get_buses, const Viewport& viewport) const;
+
+        /*
+        * Слой с найденным маршрутом в координатах полной карты: поездки выделяются линиями цвета маршрута 
+        * на подложке, остановки посадки и пересадок и конечная остановка отмечаются кружками.
+        * Координаты берутся из готовой раскладки, поэтому время отрисовки пропорционально длине маршрута
+        */
+        svg::Document RenderRouteOverlay(const BusesProvider& get_buses, const std::vector<RouteLeg>& legs) const;
+        /*
+        * Слой изохроны в координатах полной карты: достижимые остановки отмечаются кружками цвета своего интервала времени,
+        * k-й интервал получает k-й цвет color_palette. Ближние интервалы рисуются поверх дальних.
+        * Остановки, которых нет на карте, пропускаются
+        */
+        svg::Document RenderIsochroneOverlay(const BusesProvider& get_buses, const std::vector<IsochroneStop>& stops) const;
         
         private:
 
+            // Для каждого маршрута раскладки — номера оставшихся после упрощения остановок в Route::stop_indices
+            using SimplifiedRoutes = std::vector<std::vector<size_t>>;
+
+            // Пространственные индексы по экранной геометрии полной карты для отрисовки её фрагментов
+            struct TileIndex 
+            {
+                // Отрезок ломаной маршрута между точками paths[route][position] и paths[route][position + 1]
+                struct Segment 
+                {
+                    uint32_t route = 0;
+                    uint32_t position = 0;
+                };
+
+                // Надпись с номером маршрута у конечной остановки
+                struct BusLabel 
+                {
+                    uint32_t route = 0;
+                    size_t stop = 0;
+                };
+
+                std::vector<std::vector<size_t>> paths;
+                // Отрезки всех маршрутов подряд, в порядке маршрутов и точек ломаной
+                std::vector<Segment> segments;
+                // Надписи в порядке вывода на полной карте
+                std::vector<BusLabel> bus_labels;
+                SpatialIndex segment_index;
+                SpatialIndex stop_index;
+                SpatialIndex bus_label_index;
+                // Наибольшее удаление края надписи от точки привязки, в пикселях фрагмента
+                double bus_label_reach = 0.0;
+                double stop_label_reach = 0.0;
+                // Место названия остановки layout.stops[i] в порядке раскладки надписей
+                std::vector<uint32_t> stop_label_ranks;
+            };
+
+            /*
+            * Надписи полной карты, оставшиеся после удаления наложений: надписи маршрута layout.routes[i] 
+            * у первой и последней конечных — bus_labels[2 * i] и bus_labels[2 * i + 1], остановки layout.stops[i] — stop_labels[i]
+            */
+            struct LabelVisibility 
+            {
+                std::vector<bool> bus_labels;
+                std::vector<bool> stop_labels;
+            };
+
+            // Раскладка, индексы и отрисованная карта. Хранятся по указателю, чтобы MapRenderer оставался перемещаемым
+            struct MapCache 
+            {
+                explicit MapCache(size_t tile_cache_size)
+                    : tiles(tile_cache_size)
+                    {}
+
+                std::once_flag laid_out;
+                MapLayout layout;
+                std::once_flag indexed;
+                std::unique_ptr<TileIndex> tile_index;
+                std::once_flag rendered;
+                std::string svg;
+                std::string json;
+                // Фрагменты карты по ключу из z, x и y
+                LruCache<uint64_t, std::shared_ptr<const std::string>> tiles;
+                // Упрощённые маршруты раскладки layout по уровням детализации
+                std::array<std::once_flag, MAX_TILE_ZOOM + 1> simplified_flags;
+                std::array<SimplifiedRoutes, MAX_TILE_ZOOM + 1> simplified;
+            };
+
+            // Отрисовываемая часть карты: фрагмент или окно просмотра
+            struct Region 
+            {
+                // Видимая часть в координатах полной карты
+                Rect area;
+                // Размер пикселя изображения в координатах полной карты
+                double pixel_size = 1.0;
+                // Размеры изображения
+                double width = 0.0;
+                double height = 0.0;
+                // Координаты остановки layout.stops[i] на изображении
+                std::function<svg::Point(size_t)> project;
+                // Уровень детализации: пиксель изображения не меньше 2^-level пикселя полной карты
+                int level = 0;
+            };
+
+            // Выводит только то, что попадает в изображение; кандидаты выбираются по пространственному индексу
+            svg::Document RenderRegion(const MapLayout& layout, const TileIndex& index, const Region& region) const;
+            // Ломаные маршрутов, отсечённые по границе изображения: видимые отрезки подряд объединяются в одну ломаную
+            void RenderClippedLines(const MapLayout& layout, const TileIndex& index, const Region& region, svg::Document& document) const;
+
+            // Слои полной карты в порядке вывода
+            enum class Layer 
+            {
+                ROUTE_LINES,
+                BUS_LABELS,
+                STOP_POINTS,
+                STOP_LABELS,
+            };
+
+            // Часть слоя: объекты маршрутов (для линий и названий маршрутов) или остановок с номерами [begin, end)
+            struct LayerChunk 
+            {
+                Layer layer = Layer::ROUTE_LINES;
+                size_t begin = 0;
+                size_t end = 0;
+            };
+
+            // Наименьшая часть слоя: отрисовка меньшей части не окупает запуск потока
+            static constexpr size_t MIN_LAYER_CHUNK = 256;
+
+            // Рисует полную карту: части слоёв отрисовываются параллельно в отдельные строки и склеиваются по порядку
+            void RenderMap(const MapLayout& layout, std::string& out) const;
+            std::string RenderLayerChunk(const MapLayout& layout, const SimplifiedRoutes& simplified, const LabelVisibility& labels, 
+                                         const LayerChunk& chunk) const;
+
+            // Объекты слоёв для маршрутов или остановок раскладки с номерами [begin, end)
+            std::vector<svg::Polyline> RenderRouteLines(const MapLayout& layout, const SimplifiedRoutes& simplified, size_t begin, size_t end) const;
+            std::vector<svg::Text> RenderBusLabel(const MapLayout& layout, const LabelVisibility& labels, size_t begin, size_t end) const;
+            std::vector<svg::Circle> RenderStopPoints(const MapLayout& layout, size_t begin, size_t end) const;
+            std::vector<svg::Text> RenderStopLabel(const MapLayout& layout, const LabelVisibility& labels, size_t begin, size_t end) const;
+
+            // Раскладывает надписи полной карты; без настройки declutter_labels видимы все надписи
+            LabelVisibility PlaceLabels(const MapLayout& layout) const;
+            // Номера остановок в порядке раскладки надписей: сначала конечные, затем остальные, каждые по алфавиту
+            std::vector<size_t> GetStopLabelOrder(const MapLayout& layout) const;
+            // Прямоугольник надписи при типичной ширине символов. В отличие от EstimateLabelBox, не завышен,
+            // чтобы поиск наложений не удалял соседние надписи, которые на деле не пересекаются
+            Rect EstimateLabelFootprint(std::string_view data, svg::Point offset, int font_size) const;
+
+            bool IsSimplified() const;
+            // Упрощает маршруты с допуском simplify_tolerance пикселей полной карты, уменьшенной в 2^level раз
+            SimplifiedRoutes SimplifyRoutes(const MapLayout& layout, int level) const;
+            // Упрощённые маршруты вычисляются для каждого уровня детализации один раз
+            const SimplifiedRoutes& GetSimplifiedRoutes(const MapLayout& layout, int level) const;
+
+            // Номер цвета палитры для маршрута или интервала с номером index. Бросает std::logic_error, если палитра пуста
+            size_t GetPaletteIndex(size_t index) const;
+            // Оформление объектов одинаково для полной карты и для её фрагментов
+            svg::Polyline MakeRouteLine(size_t route_index) const;
+            // Возвращает подложку и саму надпись; в режиме compact_svg — одну надпись, подложкой которой служит обводка
+            std::vector<svg::Text> MakeBusLabel(const tc::Bus& bus, svg::Point position, size_t route_index) const;
+            svg::Circle MakeStopPoint(svg::Point position) const;
+            std::vector<svg::Text> MakeStopLabel(const tc::Stop& stop, svg::Point position) const;
+            // Округляет координаты до svg_precision знаков после запятой для компактного SVG
+            svg::Point RoundPoint(svg::Point point) const;
+            // В режиме compact_svg добавляет в документ таблицу стилей для классов, которые задают Make-функции
+            void AddStyleSheet(svg::Document& document) const;
+            // Оценка прямоугольника надписи относительно точки привязки: точных метрик шрифта у визуализатора нет
+            Rect EstimateLabelBox(std::string_view data, svg::Point offset, int font_size) const;
+
+            const MapCache& RenderCached(const BusesProvider& get_buses) const;
+            std::unique_ptr<TileIndex> BuildTileIndex(const MapLayout& layout) const;
+            const TileIndex& GetTileIndex(const BusesProvider& get_buses) const;
+
             const RenderSettings render_settings_;
+            std::unique_ptr<MapCache> map_cache_;
     };
 } // end namespace renderer
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <future>
+#include <thread>
+#include <type_traits>
+
+/*
+* Общая очередь параллельных заданий с упорядоченной выдачей результатов.
+* Задания запускаются через std::async, но одновременно выполняется не больше thread_count из них;
+* результаты передаются потребителю строго по порядку номеров заданий, поэтому порядок вывода
+* не зависит от того, какое задание завершилось первым
+*/
+namespace parallel
+{
+    // Число потоков для параллельной работы: hardware_concurrency(), но не меньше одного
+    inline size_t GetThreadCount()
+    {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Выполняет make_result(i) для i из [0, count) и передаёт результаты в on_result по возрастанию i
+    template <typename MakeResult, typename OnResult>
+    void RunOrdered(size_t count, size_t thread_count, MakeResult make_result, OnResult on_result)
+    {
+        using Result = std::invoke_result_t<MakeResult&, size_t>;
+
+        thread_count = std::max<size_t>(thread_count, 1);
+        std::deque<std::future<Result>> in_flight;
+        size_t next = 0;
+
+        while (next < count || !in_flight.empty())
+        {
+            while (next < count && in_flight.size() < thread_count)
+            {
+                in_flight.push_back(std::async(std::launch::async, make_result, next++));
+            }
+
+            on_result(in_flight.front().get());
+            in_flight.pop_front();
+        }
+    }
+} // end namespace parallel
@@ -0,0 +1,90 @@
+#include "polyline_simplifier.h"
+#include <utility>
+
+namespace renderer
+{
+    namespace
+    {
+        // Квадрат расстояния от точки до отрезка from-to
+        double SquaredDistance(svg::Point point, svg::Point from, svg::Point to)
+        {
+            const double dx = to.x - from.x;
+            const double dy = to.y - from.y;
+            const double length = dx * dx + dy * dy;
+            double t = 0.0;
+
+            if (length > 0.0)
+            {
+                t = ((point.x - from.x) * dx + (point.y - from.y) * dy) / length;
+                t = t < 0.0 ? 0.0 : (t > 1.0 ? 1.0 : t);
+            }
+
+            const double x = from.x + t * dx - point.x;
+            const double y = from.y + t * dy - point.y;
+
+            return x * x + y * y;
+        }
+    }  // end namespace
+
+    std::vector<size_t> SimplifyPolyline(const std::vector<svg::Point>& points, double tolerance)
+    {
+        std::vector<size_t> kept;
+
+        if (points.size() <= 2 || !(tolerance > 0.0))
+        {
+            kept.reserve(points.size());
+
+            for (size_t i = 0; i < points.size(); ++i)
+            {
+                kept.push_back(i);
+            }
+
+            return kept;
+        }
+
+        const double squared_tolerance = tolerance * tolerance;
+        std::vector<bool> keep(points.size(), false);
+        keep.front() = true;
+        keep.back() = true;
+
+        // Участки ломаной обрабатываются через явный стек, чтобы длинные маршруты не приводили к глубокой рекурсии
+        std::vector<std::pair<size_t, size_t>> ranges{ { 0, points.size() - 1 } };
+
+        while (!ranges.empty())
+        {
+            const auto [first, last] = ranges.back();
+            ranges.pop_back();
+
+            double max_distance = 0.0;
+            size_t farthest = first;
+
+            for (size_t i = first + 1; i < last; ++i)
+            {
+                const double distance = SquaredDistance(points[i], points[first], points[last]);
+
+                if (distance > max_distance)
+                {
+                    max_distance = distance;
+                    farthest = i;
+                }
+            }
+
+            if (max_distance > squared_tolerance)
+            {
+                keep[farthest] = true;
+                ranges.push_back({ first, farthest });
+                ranges.push_back({ farthest, last });
+            }
+        }
+
+        for (size_t i = 0; i < points.size(); ++i)
+        {
+            if (keep[i])
+            {
+                kept.push_back(i);
+            }
+        }
+
+        return kept;
+    }
+} // end namespace renderer
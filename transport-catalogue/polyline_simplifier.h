@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "svg.h"
+
+namespace renderer
+{
+    /*
+    * Упрощает ломаную алгоритмом Дугласа — Пекера: вершина отбрасывается, если она отстоит
+    * от отрезка между оставленными соседями не дальше чем на tolerance.
+    * Возвращает номера оставленных вершин по возрастанию; первая и последняя вершины остаются всегда
+    */
+    std::vector<size_t> SimplifyPolyline(const std::vector<svg::Point>& points, double tolerance);
+} // end namespace renderer
@@ -3,22 +3,152 @@
 
 using namespace std::literals;
 
-    const std::set<std::string> RequestHandler::GetBusesByStop(std::string_view stop_name) const 
+    const renderer::MapRenderer& RequestHandler::GetRenderer() const 
+    {
+        if (subsystems_->wait) 
+        {
+            subsystems_->wait(Subsystem::RENDERER);
+        }
+
+        std::call_once(subsystems_->renderer_built, [this]() 
+        {
+            if (!subsystems_->renderer) 
+            {
+                subsystems_->own_renderer = subsystems_->make_renderer();
+                subsystems_->renderer = subsystems_->own_renderer.get();
+            }
+        });
+
+        return *subsystems_->renderer;
+    }
+
+    const tc::TransportRouter& RequestHandler::GetRouter() const 
+    {
+        if (subsystems_->wait && !subsystems_->router.load()) 
+        {
+            subsystems_->wait(Subsystem::ROUTER);
+        }
+
+        std::call_once(subsystems_->router_built, [this]() 
+        {
+            if (!subsystems_->router) 
+            {
+                subsystems_->own_router = subsystems_->make_router();
+                subsystems_->router = subsystems_->own_router.get();
+            }
+        });
+
+        return *subsystems_->router;
+    }
+
+    const tc::TransportRouter* RequestHandler::FindRouter() const 
+    {
+        return subsystems_->router.load();
+    }
+
+    void RequestHandler::SetSubsystemWait(SubsystemWait wait) 
+    {
+        subsystems_->wait = std::move(wait);
+    }
+
+    const std::set<std::string>& RequestHandler::GetBusesByStop(std::string_view stop_name) const 
     {
         return catalogue_.GetStop(stop_name)->buses;
     }
 
     const std::optional<graph::Router<double>::RouteInfo> RequestHandler::GetRoute(const tc::Stop* stop_from, const tc::Stop* stop_to) const 
     {
-        return router_.GetRoute(stop_from, stop_to);
+        if (subsystems_->wait) 
+        {
+            subsystems_->wait(Subsystem::ROUTE_TABLE);
+        }
+
+        return GetRouter().GetRoute(stop_from, stop_to);
+    }
+
+    tc::TransportRouter::RoutesFrom RequestHandler::GetRoutesFrom(const tc::Stop* stop_from) const 
+    {
+        if (subsystems_->wait) 
+        {
+            subsystems_->wait(Subsystem::ROUTE_TABLE);
+        }
+
+        return GetRouter().GetRoutesFrom(stop_from);
+    }
+
+    std::vector<tc::StopArrival> RequestHandler::GetReachableStops(const tc::Stop* stop_from, double time_limit) const 
+    {
+        return GetRouter().GetReachableStops(stop_from, time_limit);
     }
 
     const graph::DirectedWeightedGraph<double>& RequestHandler::GetGraph() const 
     {
-        return router_.GetRouteGraph();
+        return GetRouter().GetRouteGraph();
     }
 
     svg::Document RequestHandler::RenderMap() const                                             
     {
-        return renderer_.GetSVG(catalogue_.GetAllBuses());
+        return GetRenderer().GetSVG(catalogue_.GetAllBuses());
+    }
+
+    const std::string& RequestHandler::GetMapJson() const 
+    {
+        if (subsystems_->wait) 
+        {
+            subsystems_->wait(Subsystem::MAP);
+        }
+
+        return GetRenderer().GetMapJson([this]() 
+        { 
+            return catalogue_.GetAllBuses(); 
+        });
+    }
+
+    std::shared_ptr<const std::string> RequestHandler::GetMapTileJson(int z, int x, int y) const 
+    {
+        return GetRenderer().GetTileJson([this]() 
+        { 
+            return catalogue_.GetAllBuses(); 
+        }, z, x, y);
+    }
+
+    std::string RequestHandler::GetMapViewportJson(const renderer::Viewport& viewport) const 
+    {
+        return GetRenderer().GetViewportJson([this]() 
+        { 
+            return catalogue_.GetAllBuses(); 
+        }, viewport);
+    }
+
+    std::vector<renderer::RouteLeg> RequestHandler::GetRouteLegs(const graph::Router<double>::RouteInfo& route) const 
+    {
+        std::vector<renderer::RouteLeg> legs;
+
+        for (graph::EdgeId edge_id : route.edges) 
+        {
+            const tc::EdgeSpan& span = GetRouter().GetEdgeSpan(edge_id);
+
+            if (span.bus) 
+            {
+                legs.push_back({ span.bus, GetRouter().GetEdgeStops(edge_id) });
+            }
+        }
+
+        return legs;
+    }
+
+    svg::Document RequestHandler::RenderRouteOverlay(const graph::Router<double>::RouteInfo& route) const 
+    {
+        return GetRenderer().RenderRouteOverlay([this]() 
+        { 
+            return catalogue_.GetAllBuses(); 
+        }, GetRouteLegs(route));
+    }
+
+    svg::Document RequestHandler::RenderIsochroneOverlay(const std::vector<renderer::IsochroneStop>& stops) const 
+    {
+        return GetRenderer().RenderIsochroneOverlay([this]() 
+        { 
+            return catalogue_.GetAllBuses(); 
+        }, stops);
     }
\ No newline at end of file
@@ -1,7 +1,12 @@
 #pragma once
 
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <optional>
+#include <vector>
 
 #include "json.h"
 #include "transport_catalogue.h"
@@ -12,23 +17,89 @@ class RequestHandler
 {
     public:
     
+        using RendererFactory = std::function<std::unique_ptr<renderer::MapRenderer>()>;
+        using RouterFactory = std::function<std::unique_ptr<tc::TransportRouter>()>;
+
+        enum class Subsystem 
+        {
+            RENDERER,
+            // Карта, отрисованная целиком
+            MAP,
+            // Маршрутизатор с графом маршрутов
+            ROUTER,
+            // Таблица кратчайших путей маршрутизатора
+            ROUTE_TABLE,
+        };
+
+        // Вызывается перед обращением к подсистеме, которая может ещё строиться в другом потоке
+        using SubsystemWait = std::function<void(Subsystem subsystem)>;
+
         RequestHandler(const tc::TransportCatalogue& catalogue, const renderer::MapRenderer& renderer, const tc::TransportRouter& router)
             : catalogue_(catalogue)
-            , renderer_(renderer)
-            , router_(router)
-            {}
+            , subsystems_(std::make_unique<Subsystems>())
+            {
+                subsystems_->renderer = &renderer;
+                subsystems_->router = &router;
+            }
+
+        // Визуализатор и маршрутизатор создаются при первом обращении к ним, в том числе из разных потоков
+        RequestHandler(const tc::TransportCatalogue& catalogue, RendererFactory make_renderer, RouterFactory make_router)
+            : catalogue_(catalogue)
+            , subsystems_(std::make_unique<Subsystems>())
+            {
+                subsystems_->make_renderer = std::move(make_renderer);
+                subsystems_->make_router = std::move(make_router);
+            }
+
+        // При ленивом создании первый вызов строит подсистему; его можно сделать заранее, чтобы запросы не ждали построения
+        const renderer::MapRenderer& GetRenderer() const;
+        const tc::TransportRouter& GetRouter() const;
+        // Маршрутизатор, если он уже построен; не строит его и не ждёт построения
+        const tc::TransportRouter* FindRouter() const;
+        // Задаёт ожидание подсистем, например задач запуска, которые их строят; вызывается до обращений из других потоков
+        void SetSubsystemWait(SubsystemWait wait);
 
         // Возврашает список автобусов по остановке
-        const std::set<std::string> GetBusesByStop(std::string_view stop_name) const;
+        const std::set<std::string>& GetBusesByStop(std::string_view stop_name) const;
         // Возвращает наиболее оптимальный маршрут от остановки
         const std::optional<graph::Router<double>::RouteInfo> GetRoute(const tc::Stop* stop_from, const tc::Stop* stop_to) const;
+        // Маршруты из одной остановки во многие по одному дереву путей
+        tc::TransportRouter::RoutesFrom GetRoutesFrom(const tc::Stop* stop_from) const;
+        // Остановки, до которых можно доехать не дольше time_limit минут; нужен только граф маршрутов
+        std::vector<tc::StopArrival> GetReachableStops(const tc::Stop* stop_from, double time_limit) const;
         const graph::DirectedWeightedGraph<double>& GetGraph() const;
         svg::Document RenderMap() const;
+        // Карта в виде готовой JSON-строки; отрисовывается один раз
+        const std::string& GetMapJson() const;
+        // Фрагмент карты z/x/y в виде готовой JSON-строки
+        std::shared_ptr<const std::string> GetMapTileJson(int z, int x, int y) const;
+        // Окно просмотра карты в виде готовой JSON-строки
+        std::string GetMapViewportJson(const renderer::Viewport& viewport) const;
+        // Поездки найденного маршрута с остановками, через которые они проходят; ожидания пропускаются
+        std::vector<renderer::RouteLeg> GetRouteLegs(const graph::Router<double>::RouteInfo& route) const;
+        // Слой с найденным маршрутом для наложения на карту
+        svg::Document RenderRouteOverlay(const graph::Router<double>::RouteInfo& route) const;
+        // Слой изохроны для наложения на карту
+        svg::Document RenderIsochroneOverlay(const std::vector<renderer::IsochroneStop>& stops) const;
 
     private:
 
         // RequestHandler использует агрегацию объектов "Транспортный Справочник", "Визуализатор Карты" и "Транспортный роутер"
         const tc::TransportCatalogue& catalogue_;
-        const renderer::MapRenderer& renderer_;
-        const tc::TransportRouter& router_;
+
+        // Подсистемы, переданные готовыми или созданные фабриками при первом обращении
+        struct Subsystems 
+        {
+            RendererFactory make_renderer;
+            RouterFactory make_router;
+            SubsystemWait wait;
+            std::once_flag renderer_built;
+            std::once_flag router_built;
+            std::unique_ptr<renderer::MapRenderer> own_renderer;
+            std::unique_ptr<tc::TransportRouter> own_router;
+            const renderer::MapRenderer* renderer = nullptr;
+            std::atomic<const tc::TransportRouter*> router = nullptr;
+        };
+
+        std::unique_ptr<Subsystems> subsystems_;
 };
\ No newline at end of file
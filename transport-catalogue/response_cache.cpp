@@ -0,0 +1,119 @@
+#include "response_cache.h"
+#include <charconv>
+#include <iterator>
+
+using namespace std::literals;
+
+namespace json_reader 
+{
+    ResponseCache::ResponseCache(const tc::TransportCatalogue& catalogue, const json::PrintSettings& settings, Serializer stop_serializer, Serializer bus_serializer)
+        : catalogue_(catalogue)
+        , settings_(settings)
+        , stop_serializer_(std::move(stop_serializer))
+        , bus_serializer_(std::move(bus_serializer))
+        {}
+
+    void ResponseCache::Prepare() 
+    {
+        std::lock_guard guard(mutex_);
+
+        for (const auto& [name, stop] : catalogue_.GetAllStops()) 
+        {
+            stops_.emplace(stop, MakeFragment(name, stop_serializer_));
+        }
+
+        for (const auto& [name, bus] : catalogue_.GetAllBuses()) 
+        {
+            buses_.emplace(bus, MakeFragment(name, bus_serializer_));
+        }
+
+        prepared_ = true;
+    }
+
+    void ResponseCache::WriteStop(std::string_view stop_name, int id, json::Writer& writer) 
+    {
+        const tc::Stop* stop = catalogue_.GetStop(stop_name);
+
+        if (!stop) 
+        {
+            // Ответ "not found" не зависит от названия и сериализуется напрямую
+            stop_serializer_(stop_name, id, writer);
+            return;
+        }
+
+        Write(GetFragment(stops_, stop, stop_name, stop_serializer_), stop_name, id, stop_serializer_, writer);
+    }
+
+    void ResponseCache::WriteBus(std::string_view bus_name, int id, json::Writer& writer) 
+    {
+        const tc::Bus* bus = catalogue_.GetBus(bus_name);
+
+        if (!bus) 
+        {
+            bus_serializer_(bus_name, id, writer);
+            return;
+        }
+
+        Write(GetFragment(buses_, bus, bus_name, bus_serializer_), bus_name, id, bus_serializer_, writer);
+    }
+
+    template <typename Object>
+    const ResponseCache::Fragment& ResponseCache::GetFragment(Fragments<Object>& fragments, const Object* object, std::string_view name, const Serializer& serializer) 
+    {
+        if (prepared_) 
+        {
+            return fragments.at(object);
+        }
+
+        // Ссылки на элементы unordered_map остаются действительными при последующих вставках
+        std::lock_guard guard(mutex_);
+        auto it = fragments.find(object);
+
+        if (it == fragments.end()) 
+        {
+            it = fragments.emplace(object, MakeFragment(name, serializer)).first;
+        }
+
+        return it->second;
+    }
+
+    ResponseCache::Fragment ResponseCache::MakeFragment(std::string_view name, const Serializer& serializer) const 
+    {
+        std::string bytes;
+
+        {
+            json::Writer writer(bytes, settings_, /* base_depth */ 1);
+            serializer(name, 0, writer);
+        }
+
+        // request_id — единственный ключ с таким именем, после него в ответах Stop и Bus строк нет,
+        // поэтому последнее вхождение ключа указывает на подставляемое значение
+        const std::string_view key = settings_.compact ? "\"request_id\":"sv : "\"request_id\": "sv;
+        const size_t key_pos = bytes.rfind(key);
+
+        if (key_pos == std::string::npos || bytes.compare(key_pos + key.size(), 1, "0"sv) != 0) 
+        {
+            return {};
+        }
+
+        const size_t id_pos = key_pos + key.size();
+
+        return { bytes.substr(0, id_pos), bytes.substr(id_pos + 1), true };
+    }
+
+    void ResponseCache::Write(const Fragment& fragment, std::string_view name, int id, const Serializer& serializer, json::Writer& writer) const 
+    {
+        if (!fragment.valid) 
+        {
+            serializer(name, id, writer);
+            return;
+        }
+
+        char chars[16];
+        const auto result = std::to_chars(std::begin(chars), std::end(chars), id);
+
+        writer.RawValue(fragment.prefix)
+              .Raw({ chars, static_cast<size_t>(result.ptr - chars) })
+              .Raw(fragment.suffix);
+    }
+} // end namespace json_reader
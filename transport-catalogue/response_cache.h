@@ -0,0 +1,72 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "json_writer.h"
+#include "transport_catalogue.h"
+
+namespace json_reader
+{
+    /*
+    * Кэш заранее сериализованных ответов на запросы Stop и Bus.
+    * Набор остановок и маршрутов после загрузки не меняется, поэтому тело ответа сериализуется один раз —
+    * при первом запросе (LAZY) или сразу для всего справочника (EAGER).
+    * При ответе в готовые байты подставляется только request_id.
+    * Фрагменты рассчитаны на вставку элементом верхнеуровневого массива ответов.
+    */
+    class ResponseCache 
+    {
+        public:
+
+            enum class Mode 
+            {
+                NONE,
+                LAZY,
+                EAGER,
+            };
+
+            // Сериализует полный ответ на запрос к остановке или маршруту с названием name
+            using Serializer = std::function<void(std::string_view name, int id, json::Writer& writer)>;
+
+            ResponseCache(const tc::TransportCatalogue& catalogue, const json::PrintSettings& settings, Serializer stop_serializer, Serializer bus_serializer);
+
+            // Сериализует ответы для всех остановок и маршрутов справочника
+            void Prepare();
+            void WriteStop(std::string_view stop_name, int id, json::Writer& writer);
+            void WriteBus(std::string_view bus_name, int id, json::Writer& writer);
+
+        private:
+
+            // Ответ, разделённый на байты до и после значения request_id
+            struct Fragment 
+            {
+                std::string prefix;
+                std::string suffix;
+                // false, если ответ не удалось разделить; тогда он сериализуется заново при каждом запросе
+                bool valid = false;
+            };
+
+            template <typename Object>
+            using Fragments = std::unordered_map<const Object*, Fragment>;
+
+            template <typename Object>
+            const Fragment& GetFragment(Fragments<Object>& fragments, const Object* object, std::string_view name, const Serializer& serializer);
+            Fragment MakeFragment(std::string_view name, const Serializer& serializer) const;
+            void Write(const Fragment& fragment, std::string_view name, int id, const Serializer& serializer, json::Writer& writer) const;
+
+            const tc::TransportCatalogue& catalogue_;
+            json::PrintSettings settings_;
+            Serializer stop_serializer_;
+            Serializer bus_serializer_;
+
+            // После Prepare кэш только читается, и блокировка не нужна
+            bool prepared_ = false;
+            std::mutex mutex_;
+            Fragments<tc::Stop> stops_;
+            Fragments<tc::Bus> buses_;
+    };
+} // end namespace json_reader
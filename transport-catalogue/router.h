@@ -4,10 +4,13 @@
 #include <cassert>
 #include <cstdint>
 #include <iterator>
+#include <functional>
 #include <optional>
+#include <queue>
 #include <stdexcept>
 #include <unordered_map>
 #include <map>
+#include <memory>
 #include <utility>
 #include <vector>
 
@@ -31,51 +34,141 @@ namespace graph
 
         public:
 
+            // Кратчайший путь между парой вершин: его вес и код последнего ребра.
+            // Запись не содержит указателей, поэтому таблицу путей можно использовать прямо из отображённого в память файла
+            struct RouteEntry 
+            {
+                Weight weight;
+                uint32_t prev_edge;     // NO_ROUTE, NO_EDGE или номер ребра плюс EDGE_BASE
+                uint32_t reserved;
+            };
+
+            static constexpr uint32_t NO_ROUTE = 0;     // пути нет
+            static constexpr uint32_t NO_EDGE = 1;      // путь из вершины в неё саму
+            static constexpr uint32_t EDGE_BASE = 2;
+
+            // Таблица кратчайших путей V×V: запись для пары (from, to) лежит по индексу from * V + to
+            using RouteTable = std::vector<RouteEntry>;
+
             // Конструктор маршрутизатора имеет сложность 
             // 𝑂(𝑉3+𝐸)O(V 3+E), где 𝑉 — количество вершин графа, 𝐸 — количество рёбер.
             Router(const Graph& graph)
                 : graph_(graph)
-                , routes_internal_data_(graph.GetVertexCount(), std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount()))
+                , vertex_count_(graph.GetVertexCount())
+                , owned_routes_(vertex_count_ * vertex_count_, RouteEntry{ ZERO_WEIGHT, NO_ROUTE, 0 })
+                , routes_(owned_routes_.data())
                 {
                     InitializeRoutesInternalData(graph);
-
-                    const size_t vertex_count = graph.GetVertexCount();
                     
-                    for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) 
+                    for (VertexId vertex_through = 0; vertex_through < vertex_count_; ++vertex_through) 
                     {
-                        RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
+                        RelaxRoutesInternalDataThroughVertex(vertex_count_, vertex_through);
                     }
                 }
 
+            // Восстанавливает маршрутизатор по готовой таблице путей без пересчёта
+            Router(const Graph& graph, RouteTable routes)
+                : graph_(graph)
+                , vertex_count_(graph.GetVertexCount())
+                , owned_routes_(std::move(routes))
+                , routes_(owned_routes_.data())
+                {
+                    assert(owned_routes_.size() == vertex_count_ * vertex_count_);
+                }
+
+            // Использует чужую таблицу путей из V×V записей без копирования, например отображённую в память.
+            // storage удерживает память таблицы, пока жив маршрутизатор
+            Router(const Graph& graph, const RouteEntry* routes, std::shared_ptr<const void> storage)
+                : graph_(graph)
+                , vertex_count_(graph.GetVertexCount())
+                , routes_(routes)
+                , storage_(std::move(storage))
+                {}
+
+            // Отличия графа от графа предыдущего маршрутизатора: вершины только добавляются, рёбра добавляются и удаляются
+            struct GraphChange 
+            {
+                // Новый номер каждой вершины прежнего графа
+                std::vector<VertexId> vertex_map;
+                // Новый номер каждого ребра прежнего графа; nullopt, если ребро удалено или изменилось
+                std::vector<std::optional<EdgeId>> edge_map;
+                // Рёбра нового графа, у которых нет прежнего ребра
+                std::vector<EdgeId> new_edges;
+            };
+
+            // Чинит таблицу путей previous под изменённый граф вместо пересчёта за O(V^3): строки переносятся с новыми номерами,
+            // и в каждой заново ищутся только пути, которые проходили через удалённые рёбра или сокращаются новыми рёбрами.
+            // Номера прежних вершин в vertex_map должны возрастать. Граф previous должен быть жив во время построения
+            Router(const Graph& graph, const Router& previous, const GraphChange& change)
+                : graph_(graph)
+                , vertex_count_(graph.GetVertexCount())
+                , owned_routes_(vertex_count_ * vertex_count_, RouteEntry{ ZERO_WEIGHT, NO_ROUTE, 0 })
+                , routes_(owned_routes_.data())
+                {
+                    RepairRoutes(previous, change);
+                }
+
             struct RouteInfo 
             {
                 Weight weight;
                 std::vector<EdgeId> edges;
             };
 
+            // Кратчайшие пути из одной вершины во все остальные — строка таблицы путей.
+            // Запросы из одной вершины в разные используют одно дерево путей, не обращаясь к остальной таблице
+            class RouteTree 
+            {
+                public:
+
+                    // Вес кратчайшего пути в вершину to; nullopt, если пути нет
+                    std::optional<Weight> GetWeight(VertexId to) const;
+                    std::optional<RouteInfo> BuildRoute(VertexId to) const;
+
+                private:
+
+                    friend class Router;
+
+                    RouteTree(const Router& router, VertexId from)
+                        : router_(router)
+                        , row_(router.routes_ + from * router.vertex_count_)
+                        {}
+
+                    const RouteEntry& GetEntry(VertexId to) const;
+
+                    const Router& router_;
+                    const RouteEntry* row_;
+            };
+
             // Построение маршрута на готовом маршрутизаторе линейно относительно количества рёбер в маршруте. 
             // Таким образом, основная нагрузка построения оптимальных путей ложится на конструктор.
             std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+            RouteTree GetRouteTree(VertexId from) const;
+            /*
+            * Вершины graph, достижимые из from путём веса не больше limit, с весами путей в порядке их возрастания.
+            * Поиск Дейкстры по графу останавливается, как только фронт выходит за limit, и не нуждается в таблице путей,
+            * поэтому его время и память зависят от числа достигнутых вершин и их рёбер, а не от размера графа
+            */
+            static std::vector<std::pair<VertexId, Weight>> FindReachable(const Graph& graph, VertexId from, Weight limit);
             void SetVertexId(std::map<const tc::Stop*, graph::VertexId> stop_to_vertex_id);
             graph::VertexId GetVertexId(const tc::Stop* stop);
             const graph::DirectedWeightedGraph<double>& GetGraph() const;
+            // Таблица путей из GetVertexCount() * GetVertexCount() записей
+            const RouteEntry* GetRouteTable() const;
+            // Число путей, найденных заново при починке; у маршрутизатора, построенного заново, равно нулю
+            size_t GetRepairedRouteCount() const;
 
         private:
 
-            struct RouteInternalData 
+            RouteEntry& GetEntry(VertexId from, VertexId to) 
             {
-                Weight weight;
-                std::optional<EdgeId> prev_edge;
-            };
-
-            using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
+                return owned_routes_[from * vertex_count_ + to];
+            }
 
             void InitializeRoutesInternalData(const Graph& graph) 
             {
-                const size_t vertex_count = graph.GetVertexCount();
-                for (VertexId vertex = 0; vertex < vertex_count; ++vertex) 
+                for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) 
                 {
-                    routes_internal_data_[vertex][vertex] = RouteInternalData{ ZERO_WEIGHT, std::nullopt };
+                    GetEntry(vertex, vertex) = RouteEntry{ ZERO_WEIGHT, NO_EDGE, 0 };
                     
                     for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) 
                     {
@@ -86,23 +179,23 @@ namespace graph
                             // Маршрутизатор не работает с графами, имеющими рёбра отрицательного веса.
                             throw std::domain_error("Edges' weights should be non-negative");
                         }
-                        auto& route_internal_data = routes_internal_data_[vertex][edge.to];
-                        if (!route_internal_data || route_internal_data->weight > edge.weight) {
-                            route_internal_data = RouteInternalData{ edge.weight, edge_id };
+                        auto& route_internal_data = GetEntry(vertex, edge.to);
+                        if (route_internal_data.prev_edge == NO_ROUTE || route_internal_data.weight > edge.weight) {
+                            route_internal_data = RouteEntry{ edge.weight, static_cast<uint32_t>(edge_id + EDGE_BASE), 0 };
                         }
                     }
                 }
             }
 
-            void RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteInternalData& route_from, const RouteInternalData& route_to) 
+            void RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteEntry& route_from, const RouteEntry& route_to) 
             {
-                auto& route_relaxing = routes_internal_data_[vertex_from][vertex_to];
+                auto& route_relaxing = GetEntry(vertex_from, vertex_to);
                 const Weight candidate_weight = route_from.weight + route_to.weight;
                 
-                if (!route_relaxing || candidate_weight < route_relaxing->weight) 
+                if (route_relaxing.prev_edge == NO_ROUTE || candidate_weight < route_relaxing.weight) 
                 {
                     route_relaxing = { candidate_weight,
-                                        route_to.prev_edge ? route_to.prev_edge : route_from.prev_edge };
+                                        route_to.prev_edge != NO_EDGE ? route_to.prev_edge : route_from.prev_edge, 0 };
                 }
             }
 
@@ -110,22 +203,247 @@ namespace graph
             {
                 for (VertexId vertex_from = 0; vertex_from < vertex_count; ++vertex_from) 
                 {
-                    if (const auto& route_from = routes_internal_data_[vertex_from][vertex_through]) 
+                    const auto& route_from = GetEntry(vertex_from, vertex_through);
+                    if (route_from.prev_edge == NO_ROUTE) 
+                    {
+                        continue;
+                    }
+
+                    for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) 
+                    {
+                        const auto& route_to = GetEntry(vertex_through, vertex_to);
+                        if (route_to.prev_edge != NO_ROUTE) 
+                        {
+                            RelaxRoute(vertex_from, vertex_to, route_from, route_to);
+                        }
+                    }
+                }
+            }
+
+            const RouteEntry& GetEntry(VertexId from, VertexId to) const 
+            {
+                return routes_[from * vertex_count_ + to];
+            }
+
+            using QueueItem = std::pair<Weight, VertexId>;
+            using RouteQueue = std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>>;
+
+            // Путь в вершину, ставший короче при починке, записывается в строку и в очередь
+            bool ImproveRoute(RouteEntry* row, VertexId vertex, Weight weight, EdgeId edge_id, RouteQueue& queue) 
+            {
+                RouteEntry& entry = row[vertex];
+
+                if (entry.prev_edge != NO_ROUTE && !(weight < entry.weight)) 
+                {
+                    return false;
+                }
+
+                entry = RouteEntry{ weight, static_cast<uint32_t>(edge_id + EDGE_BASE), 0 };
+                queue.push({ weight, vertex });
+
+                return true;
+            }
+
+            // Алгоритм Дейкстры по строке row, начиная с вершин в очереди; записи row — длины существующих путей
+            void PropagateRoutes(RouteEntry* row, RouteQueue& queue) 
+            {
+                while (!queue.empty()) 
+                {
+                    const auto [weight, vertex] = queue.top();
+                    queue.pop();
+
+                    if (row[vertex].weight < weight) 
+                    {
+                        continue;
+                    }
+
+                    ++repaired_routes_;
+
+                    for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) 
+                    {
+                        const auto& edge = graph_.GetEdge(edge_id);
+
+                        if (edge.weight < ZERO_WEIGHT) 
+                        {
+                            throw std::domain_error("Edges' weights should be non-negative");
+                        }
+
+                        ImproveRoute(row, edge.to, weight + edge.weight, edge_id, queue);
+                    }
+                }
+            }
+
+            /*
+            * Чинит строку source, перенесённую из прежней таблицы; lost — вершины, путь в которые оканчивался удалённым ребром.
+            * Пути, проходящие через удалённые рёбра, сбрасываются и ищутся заново от границы с уцелевшими путями,
+            * а новые рёбра улучшают пути дальше. Дейкстра обходит только вершины с изменившимися путями
+            */
+            void RepairSource(VertexId source, const std::vector<VertexId>& lost, const std::vector<EdgeId>& new_edges, 
+                              const std::vector<std::vector<EdgeId>>& incoming_edges, std::vector<uint8_t>& states) 
+            {
+                constexpr uint8_t UNKNOWN = 0;
+                constexpr uint8_t KEPT = 1;
+                constexpr uint8_t LOST = 2;
+
+                RouteEntry* row = &owned_routes_[source * vertex_count_];
+                RouteQueue queue;
+
+                if (!lost.empty()) 
+                {
+                    states.assign(vertex_count_, UNKNOWN);
+                    states[source] = KEPT;
+
+                    for (const VertexId vertex : lost) 
+                    {
+                        states[vertex] = LOST;
+                    }
+
+                    // Путь теряется вместе с путём в предка по дереву путей
+                    std::vector<VertexId> chain;
+
+                    for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) 
+                    {
+                        VertexId current = vertex;
+
+                        while (states[current] == UNKNOWN && row[current].prev_edge >= EDGE_BASE) 
+                        {
+                            chain.push_back(current);
+                            current = graph_.GetEdge(row[current].prev_edge - EDGE_BASE).from;
+                        }
+
+                        const uint8_t state = states[current] == LOST ? LOST : KEPT;
+
+                        for (const VertexId descendant : chain) 
+                        {
+                            states[descendant] = state;
+                        }
+
+                        states[vertex] = states[vertex] == UNKNOWN ? KEPT : states[vertex];
+                        chain.clear();
+                    }
+
+                    for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) 
+                    {
+                        if (states[vertex] == LOST) 
+                        {
+                            row[vertex] = RouteEntry{ ZERO_WEIGHT, NO_ROUTE, 0 };
+                        }
+                    }
+
+                    for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) 
+                    {
+                        if (states[vertex] != LOST) 
+                        {
+                            continue;
+                        }
+
+                        for (const EdgeId edge_id : incoming_edges[vertex]) 
+                        {
+                            const auto& edge = graph_.GetEdge(edge_id);
+
+                            if (states[edge.from] != LOST && row[edge.from].prev_edge != NO_ROUTE) 
+                            {
+                                ImproveRoute(row, vertex, row[edge.from].weight + edge.weight, edge_id, queue);
+                            }
+                        }
+                    }
+                }
+
+                for (const EdgeId edge_id : new_edges) 
+                {
+                    const auto& edge = graph_.GetEdge(edge_id);
+
+                    if (row[edge.from].prev_edge != NO_ROUTE) 
                     {
-                        for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) 
+                        ImproveRoute(row, edge.to, row[edge.from].weight + edge.weight, edge_id, queue);
+                    }
+                }
+
+                PropagateRoutes(row, queue);
+            }
+
+            void RepairRoutes(const Router& previous, const GraphChange& change) 
+            {
+                bool has_removed_edges = false;
+
+                for (const std::optional<EdgeId>& edge_id : change.edge_map) 
+                {
+                    has_removed_edges = has_removed_edges || !edge_id;
+                }
+
+                std::vector<std::vector<EdgeId>> incoming_edges(has_removed_edges ? vertex_count_ : 0);
+
+                if (has_removed_edges) 
+                {
+                    for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) 
+                    {
+                        incoming_edges[graph_.GetEdge(edge_id).to].push_back(edge_id);
+                    }
+                }
+
+                std::vector<bool> is_old_vertex(vertex_count_);
+
+                for (const VertexId vertex : change.vertex_map) 
+                {
+                    is_old_vertex[vertex] = true;
+                }
+
+                std::vector<VertexId> lost;
+                std::vector<uint8_t> states;
+                size_t old_source = 0;
+
+                for (VertexId source = 0; source < vertex_count_; ++source) 
+                {
+                    RouteEntry* row = &owned_routes_[source * vertex_count_];
+
+                    if (!is_old_vertex[source]) 
+                    {
+                        // Из новой вершины пути ищутся целиком
+                        RouteQueue queue;
+                        row[source] = RouteEntry{ ZERO_WEIGHT, NO_EDGE, 0 };
+                        queue.push({ ZERO_WEIGHT, source });
+                        PropagateRoutes(row, queue);
+                        continue;
+                    }
+
+                    // Старые вершины сохраняют порядок, поэтому строки прежней таблицы идут в том же порядке
+                    while (change.vertex_map[old_source] != source) 
+                    {
+                        ++old_source;
+                    }
+
+                    lost.clear();
+
+                    for (VertexId vertex = 0; vertex < change.vertex_map.size(); ++vertex) 
+                    {
+                        RouteEntry entry = previous.GetEntry(old_source, vertex);
+
+                        if (entry.prev_edge >= EDGE_BASE) 
                         {
-                            if (const auto& route_to = routes_internal_data_[vertex_through][vertex_to]) 
+                            const std::optional<EdgeId> edge_id = change.edge_map[entry.prev_edge - EDGE_BASE];
+
+                            if (!edge_id) 
                             {
-                                RelaxRoute(vertex_from, vertex_to, *route_from, *route_to);
+                                lost.push_back(change.vertex_map[vertex]);
                             }
+
+                            entry.prev_edge = edge_id ? static_cast<uint32_t>(*edge_id + EDGE_BASE) : NO_ROUTE;
                         }
+
+                        row[change.vertex_map[vertex]] = entry;
                     }
+
+                    RepairSource(source, lost, change.new_edges, incoming_edges, states);
                 }
             }
 
             static constexpr Weight ZERO_WEIGHT{};
             const Graph& graph_;
-            RoutesInternalData routes_internal_data_;
+            size_t vertex_count_ = 0;
+            RouteTable owned_routes_;                // пуст, если таблица чужая
+            const RouteEntry* routes_ = nullptr;
+            std::shared_ptr<const void> storage_;
+            size_t repaired_routes_ = 0;
 			std::map<const tc::Stop*, graph::VertexId> stop_to_vertex_id_ = {};
     };
 
@@ -147,23 +465,132 @@ namespace graph
         return graph_;
     }
 
+    template <typename Weight>
+    const typename Router<Weight>::RouteEntry* Router<Weight>::GetRouteTable() const 
+    { 
+        return routes_;
+    }
+
+    template <typename Weight>
+    size_t Router<Weight>::GetRepairedRouteCount() const 
+    { 
+        return repaired_routes_;
+    }
+
+    template <typename Weight>
+    typename Router<Weight>::RouteTree Router<Weight>::GetRouteTree(VertexId from) const 
+    {
+        if (from >= vertex_count_) 
+        {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+
+        return RouteTree(*this, from);
+    }
+
     template <typename Weight>
     std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from, VertexId to) const 
     {
-        const auto& route_internal_data = routes_internal_data_.at(from).at(to);
+        return GetRouteTree(from).BuildRoute(to);
+    }
+
+    template <typename Weight>
+    std::vector<std::pair<VertexId, Weight>> Router<Weight>::FindReachable(const Graph& graph, VertexId from, Weight limit) 
+    {
+        if (from >= graph.GetVertexCount()) 
+        {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+
+        // Лучшие найденные веса только для достигнутых вершин
+        std::unordered_map<VertexId, Weight> weights;
+        std::vector<std::pair<VertexId, Weight>> reachable;
+        RouteQueue queue;
+
+        weights.emplace(from, ZERO_WEIGHT);
+        queue.push({ ZERO_WEIGHT, from });
+
+        while (!queue.empty()) 
+        {
+            const auto [weight, vertex] = queue.top();
+            queue.pop();
+
+            if (limit < weight) 
+            {
+                break;
+            }
+
+            if (weights.at(vertex) < weight) 
+            {
+                continue;
+            }
+
+            reachable.push_back({ vertex, weight });
+
+            for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) 
+            {
+                const auto& edge = graph.GetEdge(edge_id);
+                const Weight candidate_weight = weight + edge.weight;
+
+                if (limit < candidate_weight) 
+                {
+                    continue;
+                }
+
+                const auto [it, inserted] = weights.emplace(edge.to, candidate_weight);
+
+                if (inserted || candidate_weight < it->second) 
+                {
+                    it->second = candidate_weight;
+                    queue.push({ candidate_weight, edge.to });
+                }
+            }
+        }
+
+        return reachable;
+    }
+
+    template <typename Weight>
+    const typename Router<Weight>::RouteEntry& Router<Weight>::RouteTree::GetEntry(VertexId to) const 
+    {
+        if (to >= router_.vertex_count_) 
+        {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+
+        return row_[to];
+    }
+
+    template <typename Weight>
+    std::optional<Weight> Router<Weight>::RouteTree::GetWeight(VertexId to) const 
+    {
+        const RouteEntry& route_internal_data = GetEntry(to);
+
+        if (route_internal_data.prev_edge == NO_ROUTE) 
+        {
+            return std::nullopt;
+        }
+
+        return route_internal_data.weight;
+    }
+
+    template <typename Weight>
+    std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::RouteTree::BuildRoute(VertexId to) const 
+    {
+        const RouteEntry& route_internal_data = GetEntry(to);
     
-        if (!route_internal_data) 
+        if (route_internal_data.prev_edge == NO_ROUTE) 
         {
             return std::nullopt;
         }
 
-        const Weight weight = route_internal_data->weight;
+        const Weight weight = route_internal_data.weight;
         std::vector<EdgeId> edges;
 
-        for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge; edge_id;
-            edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge)
+        for (uint32_t edge_code = route_internal_data.prev_edge; edge_code != NO_EDGE;
+            edge_code = row_[router_.graph_.GetEdge(edge_code - EDGE_BASE).from].prev_edge)
         {
-            edges.push_back(*edge_id);
+            edges.push_back(edge_code - EDGE_BASE);
         }
         
         std::reverse(edges.begin(), edges.end());
@@ -0,0 +1,753 @@
+#include "serialization.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std::literals;
+
+namespace serialization
+{
+    namespace
+    {
+        constexpr std::string_view SIGNATURE = "TCSNAPSH"sv;
+        // Читается иначе на машине с другим порядком байтов
+        constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+        enum class Section : uint32_t
+        {
+            CATALOGUE = 1,
+            RENDER_SETTINGS = 2,
+            GRAPH = 3,
+            ROUTES = 4,
+        };
+
+        // Запись таблицы разделов: номер, резерв, смещение содержимого от начала файла, размер и контрольная сумма
+        constexpr size_t SECTION_ENTRY_SIZE = 2 * sizeof(uint32_t) + 3 * sizeof(uint64_t);
+        // Выравнивание содержимого разделов; достаточно для записей таблицы путей
+        constexpr uint64_t SECTION_ALIGNMENT = 16;
+
+        using RouteEntry = graph::Router<double>::RouteEntry;
+
+        static_assert(std::is_trivially_copyable_v<RouteEntry> && sizeof(RouteEntry) == 16 && alignof(RouteEntry) <= SECTION_ALIGNMENT,
+                      "route table is stored in the snapshot as is");
+
+        uint64_t AlignOffset(uint64_t offset)
+        {
+            return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+        }
+
+        // У ребра ожидания нет автобуса
+        constexpr uint32_t NO_BUS = std::numeric_limits<uint32_t>::max();
+
+        // Контрольная сумма FNV-1a, вычисляемая по 8 байт за шаг
+        uint64_t Checksum(std::string_view bytes)
+        {
+            constexpr uint64_t OFFSET_BASIS = 14695981039346656037ull;
+            constexpr uint64_t PRIME = 1099511628211ull;
+
+            uint64_t hash = OFFSET_BASIS;
+            size_t i = 0;
+
+            for (; i + sizeof(uint64_t) <= bytes.size(); i += sizeof(uint64_t))
+            {
+                uint64_t word;
+                std::memcpy(&word, bytes.data() + i, sizeof(word));
+                hash = (hash ^ word) * PRIME;
+            }
+
+            for (; i < bytes.size(); ++i)
+            {
+                hash = (hash ^ static_cast<unsigned char>(bytes[i])) * PRIME;
+            }
+
+            return hash;
+        }
+
+        // Дописывает значения в конец буфера
+        class Encoder
+        {
+        public:
+
+            template <typename T>
+            void Put(T value)
+            {
+                static_assert(std::is_arithmetic_v<T>);
+                char raw[sizeof(T)];
+                std::memcpy(raw, &value, sizeof(T));
+                bytes_.append(raw, sizeof(T));
+            }
+
+            void PutString(std::string_view value)
+            {
+                Put(static_cast<uint32_t>(value.size()));
+                bytes_ += value;
+            }
+
+            void PutPoint(svg::Point point)
+            {
+                Put(point.x);
+                Put(point.y);
+            }
+
+            void PutColor(const svg::Color& color)
+            {
+                Put(static_cast<uint8_t>(color.index()));
+
+                if (const auto* name = std::get_if<std::string>(&color))
+                {
+                    PutString(*name);
+                }
+
+                else if (const auto* rgb = std::get_if<svg::Rgb>(&color))
+                {
+                    Put(rgb->red);
+                    Put(rgb->green);
+                    Put(rgb->blue);
+                }
+
+                else if (const auto* rgba = std::get_if<svg::Rgba>(&color))
+                {
+                    Put(rgba->red);
+                    Put(rgba->green);
+                    Put(rgba->blue);
+                    Put(rgba->opacity);
+                }
+            }
+
+            const std::string& GetBytes() const
+            {
+                return bytes_;
+            }
+
+        private:
+
+            std::string bytes_;
+        };
+
+        // Читает значения из буфера по порядку; при выходе за его границу бросает std::logic_error
+        class Decoder
+        {
+        public:
+
+            explicit Decoder(std::string_view bytes)
+                : bytes_(bytes)
+            {}
+
+            template <typename T>
+            T Get()
+            {
+                static_assert(std::is_arithmetic_v<T>);
+                T value;
+                std::memcpy(&value, Take(sizeof(T)).data(), sizeof(T));
+
+                return value;
+            }
+
+            std::string GetString()
+            {
+                const auto size = Get<uint32_t>();
+
+                return std::string(Take(size));
+            }
+
+            svg::Point GetPoint()
+            {
+                const auto x = Get<double>();
+                const auto y = Get<double>();
+
+                return { x, y };
+            }
+
+            svg::Color GetColor()
+            {
+                switch (Get<uint8_t>())
+                {
+                case 0:
+                    return svg::NoneColor;
+
+                case 1:
+                    return GetString();
+
+                case 2:
+                {
+                    const auto red = Get<uint8_t>();
+                    const auto green = Get<uint8_t>();
+                    const auto blue = Get<uint8_t>();
+
+                    return svg::Rgb{ red, green, blue };
+                }
+
+                case 3:
+                {
+                    const auto red = Get<uint8_t>();
+                    const auto green = Get<uint8_t>();
+                    const auto blue = Get<uint8_t>();
+                    const auto opacity = Get<double>();
+
+                    return svg::Rgba{ red, green, blue, opacity };
+                }
+                }
+
+                throw std::logic_error("wrong snapshot color"s);
+            }
+
+            // Отдаёт следующие size байт
+            std::string_view Take(size_t size)
+            {
+                if (size > bytes_.size() - position_)
+                {
+                    throw std::logic_error("truncated snapshot"s);
+                }
+
+                const std::string_view result = bytes_.substr(position_, size);
+                position_ += size;
+
+                return result;
+            }
+
+            bool AtEnd() const
+            {
+                return position_ == bytes_.size();
+            }
+
+        private:
+
+            std::string_view bytes_;
+            size_t position_ = 0;
+        };
+
+        // Номера остановок и маршрутов в алфавитном порядке названий
+        struct Numbering
+        {
+            std::vector<const tc::Stop*> stops;
+            std::vector<const tc::Bus*> buses;
+            std::unordered_map<const tc::Stop*, uint32_t> stop_ids;
+            std::unordered_map<const tc::Bus*, uint32_t> bus_ids;
+        };
+
+        Numbering NumberCatalogue(const tc::TransportCatalogue& catalogue)
+        {
+            Numbering numbering;
+
+            for (const auto& [name, stop] : catalogue.GetAllStops())
+            {
+                numbering.stop_ids.emplace(stop, static_cast<uint32_t>(numbering.stops.size()));
+                numbering.stops.push_back(stop);
+            }
+
+            for (const auto& [number, bus] : catalogue.GetAllBuses())
+            {
+                numbering.bus_ids.emplace(bus, static_cast<uint32_t>(numbering.buses.size()));
+                numbering.buses.push_back(bus);
+            }
+
+            return numbering;
+        }
+
+        std::string EncodeCatalogue(const tc::TransportCatalogue& catalogue, const Numbering& numbering)
+        {
+            Encoder encoder;
+            encoder.Put(static_cast<uint32_t>(numbering.stops.size()));
+
+            for (const tc::Stop* stop : numbering.stops)
+            {
+                encoder.PutString(stop->name);
+                encoder.Put(stop->coordinates.lat);
+                encoder.Put(stop->coordinates.lng);
+            }
+
+            encoder.Put(static_cast<uint32_t>(numbering.buses.size()));
+
+            for (const tc::Bus* bus : numbering.buses)
+            {
+                encoder.PutString(bus->number);
+                encoder.Put(static_cast<uint8_t>(bus->is_roundtrip));
+                encoder.Put(static_cast<uint32_t>(bus->stops.size()));
+
+                for (const tc::Stop* stop : bus->stops)
+                {
+                    encoder.Put(numbering.stop_ids.at(stop));
+                }
+            }
+
+            // Расстояния упорядочиваются, чтобы снимок одной и той же базы совпадал побайтно
+            std::vector<std::tuple<uint32_t, uint32_t, int>> distances;
+            distances.reserve(catalogue.GetAllDistances().size());
+
+            for (const auto& [stops, distance] : catalogue.GetAllDistances())
+            {
+                distances.emplace_back(numbering.stop_ids.at(stops.first), numbering.stop_ids.at(stops.second), distance);
+            }
+
+            std::sort(distances.begin(), distances.end());
+            encoder.Put(static_cast<uint32_t>(distances.size()));
+
+            for (const auto& [from, to, distance] : distances)
+            {
+                encoder.Put(from);
+                encoder.Put(to);
+                encoder.Put(static_cast<int32_t>(distance));
+            }
+
+            return encoder.GetBytes();
+        }
+
+        void DecodeCatalogue(std::string_view bytes, tc::TransportCatalogue& catalogue)
+        {
+            Decoder decoder(bytes);
+            std::vector<const tc::Stop*> stops(decoder.Get<uint32_t>());
+
+            for (const tc::Stop*& stop : stops)
+            {
+                std::string name = decoder.GetString();
+                const auto lat = decoder.Get<double>();
+                const auto lng = decoder.Get<double>();
+                catalogue.AddStop({ name, { lat, lng }, {} });
+                stop = catalogue.GetStop(name);
+            }
+
+            const auto get_stop = [&stops](uint32_t id)
+            {
+                if (id >= stops.size())
+                {
+                    throw std::logic_error("wrong snapshot stop"s);
+                }
+
+                return stops[id];
+            };
+
+            const auto bus_count = decoder.Get<uint32_t>();
+
+            for (uint32_t i = 0; i < bus_count; ++i)
+            {
+                tc::Bus bus;
+                bus.number = decoder.GetString();
+                bus.is_roundtrip = decoder.Get<uint8_t>() != 0;
+                bus.stops.resize(decoder.Get<uint32_t>());
+
+                for (const tc::Stop*& stop : bus.stops)
+                {
+                    stop = get_stop(decoder.Get<uint32_t>());
+                }
+
+                catalogue.AddBus(std::move(bus));
+            }
+
+            const auto distance_count = decoder.Get<uint32_t>();
+
+            for (uint32_t i = 0; i < distance_count; ++i)
+            {
+                const tc::Stop* from = get_stop(decoder.Get<uint32_t>());
+                const tc::Stop* to = get_stop(decoder.Get<uint32_t>());
+                catalogue.SetDistance(from, to, decoder.Get<int32_t>());
+            }
+
+            if (!decoder.AtEnd())
+            {
+                throw std::logic_error("wrong snapshot catalogue"s);
+            }
+        }
+
+        std::string EncodeRenderSettings(const renderer::RenderSettings& settings)
+        {
+            Encoder encoder;
+            encoder.Put(settings.width);
+            encoder.Put(settings.height);
+            encoder.Put(settings.padding);
+            encoder.Put(settings.line_width);
+            encoder.Put(settings.stop_radius);
+            encoder.Put(static_cast<int32_t>(settings.bus_label_font_size));
+            encoder.PutPoint(settings.bus_label_offset);
+            encoder.Put(static_cast<int32_t>(settings.stop_label_font_size));
+            encoder.PutPoint(settings.stop_label_offset);
+            encoder.PutColor(settings.underlayer_color);
+            encoder.Put(settings.underlayer_width);
+            encoder.Put(static_cast<uint32_t>(settings.color_palette.size()));
+
+            for (const svg::Color& color : settings.color_palette)
+            {
+                encoder.PutColor(color);
+            }
+
+            encoder.Put(static_cast<uint64_t>(settings.tile_cache_size));
+            encoder.Put(settings.simplify_tolerance);
+            encoder.Put(static_cast<uint8_t>(settings.compact_svg));
+            encoder.Put(static_cast<int32_t>(settings.svg_precision));
+            encoder.Put(static_cast<uint8_t>(settings.declutter_labels));
+
+            return encoder.GetBytes();
+        }
+
+        renderer::RenderSettings DecodeRenderSettings(std::string_view bytes)
+        {
+            Decoder decoder(bytes);
+            renderer::RenderSettings settings;
+            settings.width = decoder.Get<double>();
+            settings.height = decoder.Get<double>();
+            settings.padding = decoder.Get<double>();
+            settings.line_width = decoder.Get<double>();
+            settings.stop_radius = decoder.Get<double>();
+            settings.bus_label_font_size = decoder.Get<int32_t>();
+            settings.bus_label_offset = decoder.GetPoint();
+            settings.stop_label_font_size = decoder.Get<int32_t>();
+            settings.stop_label_offset = decoder.GetPoint();
+            settings.underlayer_color = decoder.GetColor();
+            settings.underlayer_width = decoder.Get<double>();
+            settings.color_palette.resize(decoder.Get<uint32_t>());
+
+            for (svg::Color& color : settings.color_palette)
+            {
+                color = decoder.GetColor();
+            }
+
+            settings.tile_cache_size = static_cast<size_t>(decoder.Get<uint64_t>());
+            settings.simplify_tolerance = decoder.Get<double>();
+            settings.compact_svg = decoder.Get<uint8_t>() != 0;
+            settings.svg_precision = decoder.Get<int32_t>();
+            settings.declutter_labels = decoder.Get<uint8_t>() != 0;
+
+            if (!decoder.AtEnd())
+            {
+                throw std::logic_error("wrong snapshot render settings"s);
+            }
+
+            return settings;
+        }
+
+        std::string EncodeGraph(const tc::TransportRouter& router, const Numbering& numbering)
+        {
+            Encoder encoder;
+            const tc::RoutingSettings& settings = router.GetRoutingSettings();
+            encoder.Put(static_cast<int32_t>(settings.bus_wait_time_));
+            encoder.Put(settings.bus_velocity_);
+
+            // Названия рёбер не записываются: это название остановки или номер автобуса поездки
+            const graph::DirectedWeightedGraph<double>& graph = router.GetRouteGraph();
+            encoder.Put(static_cast<uint32_t>(graph.GetVertexCount()));
+            encoder.Put(static_cast<uint32_t>(graph.GetEdgeCount()));
+
+            for (graph::EdgeId id = 0; id < graph.GetEdgeCount(); ++id)
+            {
+                const graph::Edge<double>& edge = graph.GetEdge(id);
+                const tc::EdgeSpan& span = router.GetEdgeSpan(id);
+                encoder.Put(static_cast<uint32_t>(edge.from));
+                encoder.Put(static_cast<uint32_t>(edge.to));
+                encoder.Put(static_cast<uint32_t>(edge.span_count));
+                encoder.Put(edge.weight);
+                encoder.Put(span.bus ? numbering.bus_ids.at(span.bus) : NO_BUS);
+                encoder.Put(span.first);
+                encoder.Put(span.last);
+            }
+
+            return encoder.GetBytes();
+        }
+
+        // Таблица путей записывается как есть: при загрузке она используется прямо из отображённого файла
+        std::string_view GetRouteTableBytes(const tc::TransportRouter& router)
+        {
+            const size_t vertex_count = router.GetRouteGraph().GetVertexCount();
+
+            return { reinterpret_cast<const char*>(router.GetRouteTable()), vertex_count * vertex_count * sizeof(RouteEntry) };
+        }
+
+        std::unique_ptr<tc::TransportRouter> DecodeRouter(std::string_view graph_bytes, std::string_view route_bytes,
+                                                          std::shared_ptr<const void> storage, const tc::TransportCatalogue& catalogue)
+        {
+            Decoder decoder(graph_bytes);
+            const Numbering numbering = NumberCatalogue(catalogue);
+
+            tc::RoutingSettings settings;
+            settings.bus_wait_time_ = decoder.Get<int32_t>();
+            settings.bus_velocity_ = decoder.Get<double>();
+
+            const auto vertex_count = decoder.Get<uint32_t>();
+            const auto edge_count = decoder.Get<uint32_t>();
+
+            if (vertex_count != 2 * numbering.stops.size())
+            {
+                throw std::logic_error("wrong snapshot graph"s);
+            }
+
+            graph::DirectedWeightedGraph<double> graph(vertex_count);
+            std::vector<tc::EdgeSpan> edge_spans;
+            edge_spans.reserve(edge_count);
+
+            for (uint32_t id = 0; id < edge_count; ++id)
+            {
+                const auto from = decoder.Get<uint32_t>();
+                const auto to = decoder.Get<uint32_t>();
+                const auto span_count = decoder.Get<uint32_t>();
+                const auto weight = decoder.Get<double>();
+                const auto bus_id = decoder.Get<uint32_t>();
+                tc::EdgeSpan span;
+                span.first = decoder.Get<uint32_t>();
+                span.last = decoder.Get<uint32_t>();
+
+                if (from >= vertex_count || to >= vertex_count || (bus_id != NO_BUS && bus_id >= numbering.buses.size()))
+                {
+                    throw std::logic_error("wrong snapshot graph"s);
+                }
+
+                span.bus = bus_id == NO_BUS ? nullptr : numbering.buses[bus_id];
+
+                if (span.bus && (span.first >= span.bus->stops.size() || span.last >= span.bus->stops.size()))
+                {
+                    throw std::logic_error("wrong snapshot graph"s);
+                }
+
+                graph.AddEdge({ span.bus ? span.bus->number : numbering.stops[from / 2]->name, span_count, from, to, weight });
+                edge_spans.push_back(span);
+            }
+
+            if (!decoder.AtEnd())
+            {
+                throw std::logic_error("wrong snapshot graph"s);
+            }
+
+            // Записи таблицы не проверяются поштучно: её целостность подтверждает контрольная сумма,
+            // а неверный номер ребра при построении маршрута приведёт к исключению std::out_of_range
+            if (route_bytes.size() != static_cast<size_t>(vertex_count) * vertex_count * sizeof(RouteEntry)
+                || reinterpret_cast<uintptr_t>(route_bytes.data()) % alignof(RouteEntry) != 0)
+            {
+                throw std::logic_error("wrong snapshot routes"s);
+            }
+
+            return std::make_unique<tc::TransportRouter>(settings, catalogue, std::move(graph), std::move(edge_spans),
+                                                         reinterpret_cast<const RouteEntry*>(route_bytes.data()), std::move(storage));
+        }
+
+        // Содержимое файла снимка в памяти
+        struct FileView
+        {
+            std::shared_ptr<const char> data;
+            size_t size = 0;
+        };
+
+#if defined(__unix__) || defined(__APPLE__)
+        // Отображает файл в память только для чтения. Страницы берутся из страничного кэша и разделяются всеми
+        // процессами, открывшими тот же снимок; отображение снимается вместе с последней копией data
+        FileView MapFile(const std::string& path)
+        {
+            const int fd = open(path.c_str(), O_RDONLY);
+
+            if (fd < 0)
+            {
+                throw std::logic_error("failed to open snapshot "s + path);
+            }
+
+            struct stat file_stat;
+
+            if (fstat(fd, &file_stat) != 0)
+            {
+                close(fd);
+                throw std::logic_error("failed to read snapshot "s + path);
+            }
+
+            const size_t size = static_cast<size_t>(file_stat.st_size);
+
+            if (size == 0)
+            {
+                close(fd);
+                throw std::logic_error("truncated snapshot"s);
+            }
+
+            void* address = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+            // Отображение остаётся действительным и после закрытия дескриптора
+            close(fd);
+
+            if (address == MAP_FAILED)
+            {
+                throw std::logic_error("failed to map snapshot "s + path);
+            }
+
+            FileView view;
+            view.data = std::shared_ptr<const char>(static_cast<const char*>(address), [size](const char* data)
+            {
+                munmap(const_cast<char*>(data), size);
+            });
+            view.size = size;
+
+            return view;
+        }
+#else
+        // Без mmap снимок читается целиком в буфер, выровненный под записи таблицы путей
+        FileView MapFile(const std::string& path)
+        {
+            std::ifstream input(path, std::ios::binary | std::ios::ate);
+
+            if (!input)
+            {
+                throw std::logic_error("failed to open snapshot "s + path);
+            }
+
+            const std::streamoff size = input.tellg();
+            input.seekg(0, std::ios::beg);
+
+            if (size <= 0)
+            {
+                throw std::logic_error("truncated snapshot"s);
+            }
+
+            std::shared_ptr<RouteEntry[]> buffer(new RouteEntry[static_cast<size_t>(size) / sizeof(RouteEntry) + 1]);
+            char* data = reinterpret_cast<char*>(buffer.get());
+            input.read(data, size);
+
+            if (!input)
+            {
+                throw std::logic_error("failed to read snapshot "s + path);
+            }
+
+            FileView view;
+            view.data = std::shared_ptr<const char>(buffer, data);
+            view.size = static_cast<size_t>(size);
+
+            return view;
+        }
+#endif
+    }  // end namespace
+
+    void SaveSnapshot(std::ostream& output, const tc::TransportCatalogue& catalogue, const renderer::RenderSettings& render_settings,
+                      const tc::TransportRouter& router)
+    {
+        const Numbering numbering = NumberCatalogue(catalogue);
+        const std::string catalogue_bytes = EncodeCatalogue(catalogue, numbering);
+        const std::string render_settings_bytes = EncodeRenderSettings(render_settings);
+        const std::string graph_bytes = EncodeGraph(router, numbering);
+
+        const std::pair<Section, std::string_view> sections[] = {
+            { Section::CATALOGUE, catalogue_bytes },
+            { Section::RENDER_SETTINGS, render_settings_bytes },
+            { Section::GRAPH, graph_bytes },
+            { Section::ROUTES, GetRouteTableBytes(router) },
+        };
+
+        Encoder header;
+        header.Put(BYTE_ORDER_MARK);
+        header.Put(SNAPSHOT_VERSION);
+        header.Put(static_cast<uint32_t>(std::size(sections)));
+        header.Put(uint32_t{ 0 });
+
+        // Содержимое разделов начинается с границ SECTION_ALIGNMENT сразу после таблицы разделов
+        uint64_t offset = AlignOffset(SIGNATURE.size() + header.GetBytes().size() + std::size(sections) * SECTION_ENTRY_SIZE);
+
+        for (const auto& [section, payload] : sections)
+        {
+            header.Put(static_cast<uint32_t>(section));
+            header.Put(uint32_t{ 0 });
+            header.Put(offset);
+            header.Put(static_cast<uint64_t>(payload.size()));
+            header.Put(Checksum(payload));
+            offset = AlignOffset(offset + payload.size());
+        }
+
+        output.write(SIGNATURE.data(), SIGNATURE.size());
+        output.write(header.GetBytes().data(), header.GetBytes().size());
+        uint64_t position = SIGNATURE.size() + header.GetBytes().size();
+
+        for (const auto& [section, payload] : sections)
+        {
+            const std::string padding(AlignOffset(position) - position, '\0');
+            output.write(padding.data(), padding.size());
+            output.write(payload.data(), payload.size());
+            position = AlignOffset(position) + payload.size();
+        }
+
+        if (!output)
+        {
+            throw std::logic_error("failed to write snapshot"s);
+        }
+    }
+
+    Snapshot LoadSnapshot(const std::string& path, tc::TransportCatalogue& catalogue)
+    {
+        if (!catalogue.GetAllStops().empty() || !catalogue.GetAllBuses().empty())
+        {
+            throw std::logic_error("snapshot is loaded into a non-empty catalogue"s);
+        }
+
+        const FileView file = MapFile(path);
+        const std::string_view bytes(file.data.get(), file.size);
+        Decoder decoder(bytes);
+
+        if (decoder.Take(SIGNATURE.size()) != SIGNATURE)
+        {
+            throw std::logic_error("not a transport catalogue snapshot"s);
+        }
+
+        if (decoder.Get<uint32_t>() != BYTE_ORDER_MARK)
+        {
+            throw std::logic_error("snapshot byte order differs"s);
+        }
+
+        if (decoder.Get<uint32_t>() != SNAPSHOT_VERSION)
+        {
+            throw std::logic_error("unsupported snapshot version"s);
+        }
+
+        // Разделы проверяются по контрольным суммам до разбора
+        std::unordered_map<uint32_t, std::string_view> payloads;
+        const auto section_count = decoder.Get<uint32_t>();
+        decoder.Get<uint32_t>();
+
+        for (uint32_t i = 0; i < section_count; ++i)
+        {
+            const auto section = decoder.Get<uint32_t>();
+            decoder.Get<uint32_t>();
+            const auto payload_offset = decoder.Get<uint64_t>();
+            const auto payload_size = decoder.Get<uint64_t>();
+            const auto checksum = decoder.Get<uint64_t>();
+
+            if (payload_offset > bytes.size() || payload_size > bytes.size() - payload_offset)
+            {
+                throw std::logic_error("truncated snapshot"s);
+            }
+
+            const std::string_view payload = bytes.substr(payload_offset, payload_size);
+
+            if (Checksum(payload) != checksum)
+            {
+                throw std::logic_error("wrong snapshot checksum"s);
+            }
+
+            payloads[section] = payload;
+        }
+
+        const auto get_payload = [&payloads](Section section)
+        {
+            const auto it = payloads.find(static_cast<uint32_t>(section));
+
+            if (it == payloads.end())
+            {
+                throw std::logic_error("missing snapshot section"s);
+            }
+
+            return it->second;
+        };
+
+        DecodeCatalogue(get_payload(Section::CATALOGUE), catalogue);
+
+        Snapshot snapshot;
+        snapshot.render_settings = DecodeRenderSettings(get_payload(Section::RENDER_SETTINGS));
+        snapshot.router = DecodeRouter(get_payload(Section::GRAPH), get_payload(Section::ROUTES), file.data, catalogue);
+
+        return snapshot;
+    }
+} // end namespace serialization
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+
+#include "map_renderer.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+/*
+* Двоичный снимок построенной базы: справочник, настройки визуализации и маршрутизатор с готовыми кратчайшими путями.
+* Снимок записывается один раз (make_base) и загружается при ответах на запросы (process_requests) без разбора JSON
+* и без пересчёта маршрутов.
+*
+* Формат: сигнатура, метка порядка байтов, номер версии и число разделов, затем таблица разделов. Запись таблицы —
+* номер раздела, смещение и размер его содержимого и контрольная сумма; содержимое разделов выровнено по 16 байт.
+* Таблица кратчайших путей, самая большая часть снимка, не содержит указателей и записывается как есть:
+* при загрузке файл отображается в память, и маршрутизатор читает её на месте. Такие страницы не копируются
+* в память процесса и разделяются всеми процессами, загрузившими один снимок.
+* Числа записываются в порядке байтов машины, создавшей снимок; снимок с другим порядком байтов не загружается
+*/
+namespace serialization
+{
+    // Версия формата; снимок другой версии не загружается
+    constexpr uint32_t SNAPSHOT_VERSION = 2;
+
+    // Содержимое снимка помимо справочника
+    struct Snapshot
+    {
+        renderer::RenderSettings render_settings;
+        std::unique_ptr<tc::TransportRouter> router;
+    };
+
+    void SaveSnapshot(std::ostream& output, const tc::TransportCatalogue& catalogue, const renderer::RenderSettings& render_settings,
+                      const tc::TransportRouter& router);
+    /*
+    * Заполняет пустой справочник catalogue из файла path и возвращает настройки и маршрутизатор, который ссылается
+    * на catalogue и удерживает отображение файла. Бросает std::logic_error, если файл не читается или не содержит снимка,
+    * версия не совпадает или контрольная сумма раздела неверна
+    */
+    Snapshot LoadSnapshot(const std::string& path, tc::TransportCatalogue& catalogue);
+} // end namespace serialization
@@ -0,0 +1,571 @@
+#include "server.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace std::literals;
+
+namespace server
+{
+#if defined(__unix__) || defined(__APPLE__)
+    namespace
+    {
+        // Буфер потоков ввода и вывода поверх дескриптора соединения; закрывает дескриптор при уничтожении
+        class SocketBuffer : public std::streambuf
+        {
+        public:
+
+            explicit SocketBuffer(int fd)
+                : fd_(fd)
+                , input_(BUFFER_SIZE)
+                , output_(BUFFER_SIZE)
+            {
+                setg(input_.data(), input_.data(), input_.data());
+                setp(output_.data(), output_.data() + output_.size());
+            }
+
+            SocketBuffer(const SocketBuffer&) = delete;
+            SocketBuffer& operator=(const SocketBuffer&) = delete;
+
+            ~SocketBuffer() override
+            {
+                Flush();
+                close(fd_);
+            }
+
+        protected:
+
+            int_type underflow() override
+            {
+                ssize_t count;
+
+                do
+                {
+                    count = read(fd_, input_.data(), input_.size());
+                } while (count < 0 && errno == EINTR);
+
+                if (count <= 0)
+                {
+                    return traits_type::eof();
+                }
+
+                setg(input_.data(), input_.data(), input_.data() + count);
+
+                return traits_type::to_int_type(*gptr());
+            }
+
+            int_type overflow(int_type ch) override
+            {
+                if (!Flush())
+                {
+                    return traits_type::eof();
+                }
+
+                if (!traits_type::eq_int_type(ch, traits_type::eof()))
+                {
+                    *pptr() = traits_type::to_char_type(ch);
+                    pbump(1);
+                }
+
+                return traits_type::not_eof(ch);
+            }
+
+            int sync() override
+            {
+                return Flush() ? 0 : -1;
+            }
+
+        private:
+
+            // Отправляет накопленный вывод целиком
+            bool Flush()
+            {
+                const char* data = pbase();
+                size_t size = static_cast<size_t>(pptr() - pbase());
+
+                while (size > 0)
+                {
+                    const ssize_t count = write(fd_, data, size);
+
+                    if (count < 0)
+                    {
+                        if (errno == EINTR)
+                        {
+                            continue;
+                        }
+
+                        return false;
+                    }
+
+                    data += count;
+                    size -= static_cast<size_t>(count);
+                }
+
+                setp(output_.data(), output_.data() + output_.size());
+
+                return true;
+            }
+
+            static constexpr size_t BUFFER_SIZE = 64 * 1024;
+
+            int fd_;
+            std::vector<char> input_;
+            std::vector<char> output_;
+        };
+    }  // end namespace
+#endif
+
+    namespace
+    {
+        std::optional<int> GetRequestId(const json::Node& request)
+        {
+            if (request.IsDict() && request.AsDict().count("id"s) && request.AsDict().at("id"s).IsInt())
+            {
+                return request.AsDict().at("id"s).AsInt();
+            }
+
+            return std::nullopt;
+        }
+    }  // end namespace
+
+    QueryServer::QueryServer(json_reader::JsonReader& document, VersionedBase& base, Protocol protocol)
+        : document_(document)
+        , base_(base)
+        , protocol_(protocol)
+    {}
+
+    QueryServer::~QueryServer()
+    {
+        JoinClients();
+    }
+
+    void QueryServer::Serve(std::istream& input, std::ostream& output)
+    {
+        if (protocol_ == Protocol::NDJSON)
+        {
+            std::string line;
+
+            while (std::getline(input, line))
+            {
+                // Пустые строки между запросами пропускаются
+                if (line.find_first_not_of(" \t\r"sv) != std::string::npos)
+                {
+                    ProcessLine(line, output);
+                }
+            }
+
+            return;
+        }
+
+        while (input >> std::ws && input.peek() != std::char_traits<char>::eof())
+        {
+            json::Node batch;
+
+            try
+            {
+                batch = json::LoadNode(input);
+            }
+            catch (const std::exception& error)
+            {
+                // Где кончается испорченный пакет, неизвестно: остаток строки пропускается, и разбор продолжается со следующей
+                WriteError(error.what(), std::nullopt, output);
+                input.clear();
+                input.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                continue;
+            }
+
+            // Ошибка в пакете отменяет только ответ на этот пакет
+            try
+            {
+                ProcessBatch(batch, output);
+            }
+            catch (const std::exception& error)
+            {
+                WriteError(error.what(), std::nullopt, output);
+            }
+        }
+    }
+
+    void QueryServer::ProcessRequests(const json::Node& stat_requests, std::ostream& output)
+    {
+        if (protocol_ == Protocol::NDJSON)
+        {
+            for (const json::Node& request : stat_requests.AsArray())
+            {
+                ProcessRequest(request, output);
+            }
+
+            return;
+        }
+
+        // Пакет собирается в строку целиком: ошибка в одном запросе заменяет только его ответ, а не обрывает массив
+        std::string answer;
+
+        {
+            const VersionedBase::Reader version = base_.Read();
+            json::Writer writer(answer, document_.GetPrintSettings());
+            writer.StartArray();
+
+            for (const json::Node& request : stat_requests.AsArray())
+            {
+                const std::string response = AnswerRequest(request, *version, /* base_depth */ 1);
+
+                if (!response.empty())
+                {
+                    writer.RawValue(response);
+                }
+            }
+
+            writer.EndArray();
+        }
+
+        output << answer << '\n';
+        output.flush();
+    }
+
+    void QueryServer::ProcessBatch(const json::Node& batch, std::ostream& output)
+    {
+        const json::Dict& batch_map = batch.AsDict();
+
+        if (batch_map.count("base_requests"s))
+        {
+            // Неудачное обновление не публикуется; запросы пакета относятся к нему и тоже не выполняются
+            try
+            {
+                base_.Update(batch_map.at("base_requests"s).AsArray());
+            }
+            catch (const std::exception& error)
+            {
+                WriteError(error.what(), std::nullopt, output);
+                return;
+            }
+        }
+
+        if (batch_map.count("stat_requests"s))
+        {
+            ProcessRequests(batch_map.at("stat_requests"s), output);
+        }
+
+        else
+        {
+            ProcessRequests(json::Array{}, output);
+        }
+    }
+
+    void QueryServer::ProcessLine(std::string_view line, std::ostream& output)
+    {
+        json::Node request;
+
+        try
+        {
+            request = json::LoadNode(line);
+        }
+        catch (const std::exception& error)
+        {
+            WriteError(error.what(), std::nullopt, output);
+            return;
+        }
+
+        ProcessRequest(request, output);
+    }
+
+    void QueryServer::ProcessRequest(const json::Node& request, std::ostream& output)
+    {
+        const std::optional<int> id = GetRequestId(request);
+        std::string response;
+
+        try
+        {
+            const json::Dict& request_map = request.AsDict();
+
+            if (request_map.count("type"s) && request_map.at("type"s).IsString() && request_map.at("type"s).AsString() == "Update"sv)
+            {
+                json::Writer writer(response, document_.GetPrintSettings());
+                const uint64_t number = base_.Update(request_map.at("base_requests"s).AsArray());
+                writer.StartDict();
+
+                if (id)
+                {
+                    writer.Key("request_id"sv).Value(*id);
+                }
+
+                writer.Key("version"sv).Value(static_cast<int>(number)).EndDict();
+            }
+
+            else
+            {
+                response = AnswerRequest(request, *base_.Read(), /* base_depth */ 0);
+            }
+        }
+        catch (const std::exception& error)
+        {
+            WriteError(error.what(), id, output);
+            return;
+        }
+
+        if (response.empty())
+        {
+            WriteError("unknown request type"sv, id, output);
+            return;
+        }
+
+        output << response << '\n';
+        output.flush();
+    }
+
+    std::string QueryServer::AnswerRequest(const json::Node& request, const BaseVersion& version, size_t base_depth) const
+    {
+        std::string response;
+
+        try
+        {
+            json::Writer writer(response, document_.GetPrintSettings(), base_depth);
+            document_.ProcessRequest(request.AsDict(), *version.catalogue, *version.request_handler, version.response_cache.get(), writer);
+        }
+        catch (const std::exception& error)
+        {
+            // Начатый ответ отбрасывается целиком
+            response.clear();
+            json::Writer writer(response, document_.GetPrintSettings(), base_depth);
+            PrintError(error.what(), GetRequestId(request), writer);
+        }
+
+        return response;
+    }
+
+    void QueryServer::PrintError(std::string_view message, std::optional<int> id, json::Writer& writer) const
+    {
+        writer.StartDict().Key("error_message"sv).Value(message);
+
+        if (id)
+        {
+            writer.Key("request_id"sv).Value(*id);
+        }
+
+        writer.EndDict();
+    }
+
+    void QueryServer::WriteError(std::string_view message, std::optional<int> id, std::ostream& output) const
+    {
+        std::string response;
+
+        {
+            json::Writer writer(response, document_.GetPrintSettings());
+            PrintError(message, id, writer);
+        }
+
+        output << response << '\n';
+        output.flush();
+    }
+
+#if defined(__unix__) || defined(__APPLE__)
+    void QueryServer::Listen(const std::string& path)
+    {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+
+        if (path.size() >= sizeof(address.sun_path))
+        {
+            throw std::logic_error("socket path is too long: "s + path);
+        }
+
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+        // Клиент, закрывший соединение до конца ответа, не должен завершать сервер
+        std::signal(SIGPIPE, SIG_IGN);
+
+        // Сокет, оставшийся от предыдущего запуска, удаляется; другие файлы не трогаются
+        struct stat file_stat;
+
+        if (lstat(path.c_str(), &file_stat) == 0 && S_ISSOCK(file_stat.st_mode))
+        {
+            unlink(path.c_str());
+        }
+
+        const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if (listener < 0)
+        {
+            throw std::logic_error("failed to create socket "s + path);
+        }
+
+        if (bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0)
+        {
+            close(listener);
+            throw std::logic_error("failed to listen on "s + path);
+        }
+
+        {
+            std::lock_guard guard(clients_mutex_);
+
+            // Stop, вызванный до открытия сокета, тоже останавливает сервер
+            if (stopping_)
+            {
+                close(listener);
+                unlink(path.c_str());
+                return;
+            }
+
+            listener_ = listener;
+        }
+
+        // Сокет закрывается только после того, как Stop больше не может к нему обратиться
+        const auto close_listener = [this, listener, &path]()
+        {
+            {
+                std::lock_guard guard(clients_mutex_);
+                listener_ = -1;
+            }
+
+            close(listener);
+            unlink(path.c_str());
+        };
+
+        for (;;)
+        {
+            const int client = accept(listener, nullptr, nullptr);
+            std::unique_lock guard(clients_mutex_);
+
+            if (stopping_)
+            {
+                if (client >= 0)
+                {
+                    close(client);
+                }
+
+                break;
+            }
+
+            if (client < 0)
+            {
+                if (errno == EINTR || errno == ECONNABORTED)
+                {
+                    continue;
+                }
+
+                guard.unlock();
+                JoinClients();
+                close_listener();
+                throw std::logic_error("failed to accept connection on "s + path);
+            }
+
+            ReapClients();
+
+            Client& entry = clients_.emplace_back();
+            entry.socket = client;
+            entry.thread = std::thread([this, &entry]()
+            {
+                SocketBuffer buffer(entry.socket);
+                std::istream input(&buffer);
+                std::ostream output(&buffer);
+
+                // Ошибка в пакете закрывает только соединение этого клиента
+                try
+                {
+                    Serve(input, output);
+                }
+                catch (const std::exception& error)
+                {
+                    std::cerr << "request error: "sv << error.what() << std::endl;
+                }
+
+                // Объявлен после buffer, поэтому снимается раньше, чем buffer закроет сокет
+                std::lock_guard finished_guard(clients_mutex_);
+                entry.finished = true;
+            });
+        }
+
+        JoinClients();
+        close_listener();
+    }
+
+    void QueryServer::Stop()
+    {
+        std::lock_guard guard(clients_mutex_);
+        stopping_ = true;
+
+        // shutdown прерывает accept и блокирующее чтение, но не закрывает дескрипторы: их закрывают владельцы
+        if (listener_ >= 0)
+        {
+            shutdown(listener_, SHUT_RDWR);
+        }
+
+        for (const Client& client : clients_)
+        {
+            if (!client.finished)
+            {
+                shutdown(client.socket, SHUT_RD);
+            }
+        }
+    }
+
+    void QueryServer::ReapClients()
+    {
+        for (auto it = clients_.begin(); it != clients_.end();)
+        {
+            if (it->finished)
+            {
+                // Поток уже не берёт мьютекс: он только закрывает сокет и завершается
+                it->thread.join();
+                it = clients_.erase(it);
+            }
+
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    void QueryServer::JoinClients()
+    {
+        std::list<Client> clients;
+
+        {
+            std::lock_guard guard(clients_mutex_);
+
+            for (const Client& client : clients_)
+            {
+                if (!client.finished)
+                {
+                    shutdown(client.socket, SHUT_RD);
+                }
+            }
+
+            clients.splice(clients.end(), clients_);
+        }
+
+        // Потоки завершаются, взяв мьютекс, поэтому их ждут без него
+        for (Client& client : clients)
+        {
+            client.thread.join();
+        }
+    }
+#else
+    void QueryServer::Listen(const std::string& path)
+    {
+        throw std::logic_error("unix domain sockets are not supported, can't listen on "s + path);
+    }
+
+    void QueryServer::Stop()
+    {}
+
+    void QueryServer::JoinClients()
+    {}
+#endif
+} // end namespace server
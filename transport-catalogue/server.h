@@ -0,0 +1,105 @@
+#pragma once
+
+#include <istream>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "base_versions.h"
+#include "json_reader.h"
+
+/*
+* Режим сервера: база строится один раз, после чего сервер отвечает на пакеты запросов, пока его не остановят.
+* В протоколе BATCH пакет — JSON-документ вида { "stat_requests": [ ... ] }; ответ на него — JSON-массив ответов
+* и перевод строки. Ошибка в запросе заменяет его ответ на { "error_message": ... }, а неразобранный пакет
+* или пакет с неудачным обновлением получает такой словарь вместо массива; сервер продолжает работу с текущей версией.
+* В протоколе NDJSON каждая строка — один запрос, и ответ на неё — одна строка, отправляемая сразу:
+* клиент может слать запросы, не дожидаясь ответов, а память не зависит от длины потока запросов.
+* Запросы принимаются из потока (например, std::cin после документа базы) или по сокету домена Unix.
+* Пакет с base_requests или строка { "type": "Update", "base_requests": [ ... ] } публикуют новую версию базы;
+* запросы, начатые раньше, дочитывают прежнюю. Версии базы только читаются, поэтому клиенты обслуживаются параллельно
+*/
+namespace server
+{
+    class QueryServer
+    {
+        public:
+
+            enum class Protocol 
+            {
+                BATCH,
+                NDJSON,
+            };
+
+            // Для NDJSON вывод document должен быть заранее переключён в одну строку (SetCompactOutput), до создания кэшей ответов
+            QueryServer(json_reader::JsonReader& document, VersionedBase& base, Protocol protocol = Protocol::BATCH);
+            // Дожидается потоков клиентов, если Listen не успел этого сделать
+            ~QueryServer();
+
+            QueryServer(const QueryServer&) = delete;
+            QueryServer& operator=(const QueryServer&) = delete;
+
+            // Отвечает на запросы из input до конца потока; ответ на каждый пакет или строку отправляется сразу
+            void Serve(std::istream& input, std::ostream& output);
+            /*
+            * Принимает соединения на сокете домена Unix path; каждое соединение обслуживается своим потоком, как Serve.
+            * Работает до вызова Stop: после него дожидается ответов на уже полученные запросы, закрывает сокет и возвращает управление.
+            * Бросает std::logic_error, если сокет не удалось открыть
+            */
+            void Listen(const std::string& path);
+            // Останавливает Listen: новые соединения не принимаются, а клиенты больше не читаются. Можно вызывать из другого потока
+            void Stop();
+            // Отвечает на массив stat_requests: в протоколе BATCH — одним пакетом по одной версии базы, в NDJSON — строкой на каждый запрос
+            void ProcessRequests(const json::Node& stat_requests, std::ostream& output);
+
+        private:
+
+            /*
+            * Сначала применяет base_requests пакета, затем отвечает на его stat_requests; пакет без stat_requests получает [].
+            * Если обновление не удалось, вместо ответа выводится ошибка, а версия базы остаётся прежней
+            */
+            void ProcessBatch(const json::Node& batch, std::ostream& output);
+            void ProcessLine(std::string_view line, std::ostream& output);
+            /*
+            * Отвечает на один запрос строкой NDJSON. Ответ собирается в строку целиком,
+            * поэтому при ошибке вместо обрывка ответа выводится { "error_message": ..., "request_id": ... }.
+            * На запрос Update отвечает номером опубликованной версии: { "request_id": ..., "version": ... }
+            */
+            void ProcessRequest(const json::Node& request, std::ostream& output);
+            /*
+            * Ответ на запрос к версии version, собранный в строку для вставки на уровне вложенности base_depth.
+            * При ошибке начатый ответ заменяется на { "error_message": ..., "request_id": ... }; на запрос неизвестного типа — пустая строка
+            */
+            std::string AnswerRequest(const json::Node& request, const BaseVersion& version, size_t base_depth) const;
+            void PrintError(std::string_view message, std::optional<int> id, json::Writer& writer) const;
+            // Пишет ошибку отдельной строкой; ошибка пакета целиком выводится вместо его ответа и без request_id
+            void WriteError(std::string_view message, std::optional<int> id, std::ostream& output) const;
+
+            // Соединение, обслуживаемое своим потоком
+            struct Client
+            {
+                int socket = -1;
+                std::thread thread;
+                // Выставляется под clients_mutex_ до закрытия сокета, чтобы Stop не обращался к закрытому дескриптору
+                bool finished = false;
+            };
+
+            // Дожидается завершившихся потоков клиентов и удаляет их. Вызывается под clients_mutex_
+            void ReapClients();
+            // Прекращает чтение от всех клиентов и дожидается их потоков
+            void JoinClients();
+
+            json_reader::JsonReader& document_;
+            VersionedBase& base_;
+            Protocol protocol_;
+
+            std::mutex clients_mutex_;
+            std::list<Client> clients_;
+            int listener_ = -1;
+            bool stopping_ = false;
+    };
+} // end namespace server
@@ -0,0 +1,250 @@
+#include "spatial_index.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace renderer
+{
+    namespace
+    {
+        // Биты кода положения точки относительно прямоугольника
+        enum OutCode : unsigned
+        {
+            INSIDE = 0,
+            BELOW_MIN_X = 1,
+            ABOVE_MAX_X = 2,
+            BELOW_MIN_Y = 4,
+            ABOVE_MAX_Y = 8,
+        };
+
+        unsigned ComputeOutCode(const Rect& rect, svg::Point point)
+        {
+            unsigned code = INSIDE;
+
+            if (point.x < rect.min_x)
+            {
+                code |= BELOW_MIN_X;
+            }
+
+            else if (point.x > rect.max_x)
+            {
+                code |= ABOVE_MAX_X;
+            }
+
+            if (point.y < rect.min_y)
+            {
+                code |= BELOW_MIN_Y;
+            }
+
+            else if (point.y > rect.max_y)
+            {
+                code |= ABOVE_MAX_Y;
+            }
+
+            return code;
+        }
+    }  // end namespace
+
+    Rect Rect::Bounding(svg::Point lhs, svg::Point rhs)
+    {
+        return { std::min(lhs.x, rhs.x), std::min(lhs.y, rhs.y), std::max(lhs.x, rhs.x), std::max(lhs.y, rhs.y) };
+    }
+
+    bool Rect::Intersects(const Rect& other) const
+    {
+        return min_x <= other.max_x && other.min_x <= max_x
+            && min_y <= other.max_y && other.min_y <= max_y;
+    }
+
+    bool Rect::Contains(svg::Point point) const
+    {
+        return min_x <= point.x && point.x <= max_x
+            && min_y <= point.y && point.y <= max_y;
+    }
+
+    Rect Rect::Expanded(double margin) const
+    {
+        return { min_x - margin, min_y - margin, max_x + margin, max_y + margin };
+    }
+
+    bool ClipSegment(const Rect& rect, svg::Point& from, svg::Point& to)
+    {
+        unsigned code_from = ComputeOutCode(rect, from);
+        unsigned code_to = ComputeOutCode(rect, to);
+
+        while (true)
+        {
+            // Оба конца внутри: отрезок виден целиком
+            if (!(code_from | code_to))
+            {
+                return true;
+            }
+
+            // Оба конца по одну сторону от прямоугольника: отрезок не виден
+            if (code_from & code_to)
+            {
+                return false;
+            }
+
+            // Конец снаружи переносится в точку пересечения с продолжением соответствующей стороны
+            const unsigned code = code_from ? code_from : code_to;
+            svg::Point point;
+
+            if (code & ABOVE_MAX_Y)
+            {
+                point = { from.x + (to.x - from.x) * (rect.max_y - from.y) / (to.y - from.y), rect.max_y };
+            }
+
+            else if (code & BELOW_MIN_Y)
+            {
+                point = { from.x + (to.x - from.x) * (rect.min_y - from.y) / (to.y - from.y), rect.min_y };
+            }
+
+            else if (code & ABOVE_MAX_X)
+            {
+                point = { rect.max_x, from.y + (to.y - from.y) * (rect.max_x - from.x) / (to.x - from.x) };
+            }
+
+            else
+            {
+                point = { rect.min_x, from.y + (to.y - from.y) * (rect.min_x - from.x) / (to.x - from.x) };
+            }
+
+            if (code == code_from)
+            {
+                from = point;
+                code_from = ComputeOutCode(rect, from);
+            }
+
+            else
+            {
+                to = point;
+                code_to = ComputeOutCode(rect, to);
+            }
+        }
+    }
+
+    SpatialIndex::SpatialIndex(const Rect& bounds, size_t item_count)
+        : bounds_(bounds)
+    {
+        // В среднем на ячейку приходится около одного объекта
+        const auto side = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(item_count))));
+        columns_ = std::clamp<size_t>(side, 1, MAX_CELLS_PER_AXIS);
+        rows_ = columns_;
+
+        const double width = bounds_.max_x - bounds_.min_x;
+        const double height = bounds_.max_y - bounds_.min_y;
+        cell_width_ = width > 0.0 ? width / columns_ : 1.0;
+        cell_height_ = height > 0.0 ? height / rows_ : 1.0;
+        cells_.resize(columns_ * rows_);
+    }
+
+    void SpatialIndex::Insert(const Rect& box, uint32_t id)
+    {
+        const size_t first_column = CellIndex(box.min_x, bounds_.min_x, cell_width_, columns_);
+        const size_t last_column = CellIndex(box.max_x, bounds_.min_x, cell_width_, columns_);
+        const size_t first_row = CellIndex(box.min_y, bounds_.min_y, cell_height_, rows_);
+        const size_t last_row = CellIndex(box.max_y, bounds_.min_y, cell_height_, rows_);
+
+        for (size_t row = first_row; row <= last_row; ++row)
+        {
+            for (size_t column = first_column; column <= last_column; ++column)
+            {
+                cells_[row * columns_ + column].push_back(id);
+            }
+        }
+    }
+
+    void SpatialIndex::InsertSegment(svg::Point from, svg::Point to, uint32_t id)
+    {
+        if (from.x > to.x)
+        {
+            std::swap(from, to);
+        }
+
+        const size_t first_column = CellIndex(from.x, bounds_.min_x, cell_width_, columns_);
+        const size_t last_column = CellIndex(to.x, bounds_.min_x, cell_width_, columns_);
+        const double dx = to.x - from.x;
+
+        // Отрезок обходится по столбцам сетки: в каждом столбце он занимает непрерывный диапазон строк
+        for (size_t column = first_column; column <= last_column; ++column)
+        {
+            const double strip_begin = column == first_column ? from.x : bounds_.min_x + column * cell_width_;
+            const double strip_end = column == last_column ? to.x : bounds_.min_x + (column + 1) * cell_width_;
+            const double y_begin = dx > 0.0 ? from.y + (to.y - from.y) * (strip_begin - from.x) / dx : from.y;
+            const double y_end = dx > 0.0 ? from.y + (to.y - from.y) * (strip_end - from.x) / dx : to.y;
+
+            const size_t first_row = CellIndex(std::min(y_begin, y_end), bounds_.min_y, cell_height_, rows_);
+            const size_t last_row = CellIndex(std::max(y_begin, y_end), bounds_.min_y, cell_height_, rows_);
+
+            for (size_t row = first_row; row <= last_row; ++row)
+            {
+                cells_[row * columns_ + column].push_back(id);
+            }
+        }
+    }
+
+    std::vector<uint32_t> SpatialIndex::Query(const Rect& area) const
+    {
+        std::vector<uint32_t> result;
+
+        if (!area.Intersects(bounds_))
+        {
+            return result;
+        }
+
+        const size_t first_column = CellIndex(area.min_x, bounds_.min_x, cell_width_, columns_);
+        const size_t last_column = CellIndex(area.max_x, bounds_.min_x, cell_width_, columns_);
+        const size_t first_row = CellIndex(area.min_y, bounds_.min_y, cell_height_, rows_);
+        const size_t last_row = CellIndex(area.max_y, bounds_.min_y, cell_height_, rows_);
+
+        for (size_t row = first_row; row <= last_row; ++row)
+        {
+            for (size_t column = first_column; column <= last_column; ++column)
+            {
+                const auto& cell = cells_[row * columns_ + column];
+                result.insert(result.end(), cell.begin(), cell.end());
+            }
+        }
+
+        // Объект, занимающий несколько ячеек, попадает в результат один раз
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+
+        return result;
+    }
+
+    size_t SpatialIndex::CellIndex(double value, double min, double cell_size, size_t count) const
+    {
+        const double cell = std::floor((value - min) / cell_size);
+
+        if (!(cell > 0.0))
+        {
+            return 0;
+        }
+
+        return std::min(static_cast<size_t>(cell), count - 1);
+    }
+
+    LabelPlacer::LabelPlacer(const Rect& bounds, size_t label_count)
+        : index_(bounds, label_count)
+    {
+        placed_.reserve(label_count);
+    }
+
+    bool LabelPlacer::TryPlace(const Rect& box)
+    {
+        for (uint32_t id : index_.Query(box))
+        {
+            if (placed_[id].Intersects(box))
+            {
+                return false;
+            }
+        }
+
+        index_.Insert(box, static_cast<uint32_t>(placed_.size()));
+        placed_.push_back(box);
+
+        return true;
+    }
+} // end namespace renderer
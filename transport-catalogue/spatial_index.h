@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "svg.h"
+
+namespace renderer
+{
+    // Прямоугольник в координатах SVG-изображения
+    struct Rect
+    {
+        double min_x = 0.0;
+        double min_y = 0.0;
+        double max_x = 0.0;
+        double max_y = 0.0;
+
+        // Наименьший прямоугольник, содержащий обе точки
+        static Rect Bounding(svg::Point lhs, svg::Point rhs);
+
+        bool Intersects(const Rect& other) const;
+        bool Contains(svg::Point point) const;
+        // Прямоугольник, расширенный на margin во все стороны
+        Rect Expanded(double margin) const;
+    };
+
+    /*
+    * Отсекает отрезок from-to прямоугольником rect (алгоритм Коэна — Сазерленда).
+    * Возвращает false, если отрезок целиком лежит снаружи; иначе концы заменяются концами видимой части
+    */
+    bool ClipSegment(const Rect& rect, svg::Point& from, svg::Point& to);
+
+    /*
+    * Пространственный индекс в виде равномерной сетки: объект регистрируется во всех ячейках,
+    * которые пересекает его ограничивающий прямоугольник, а отрезок — только в ячейках, через которые он проходит.
+    * Запрос возвращает кандидатов из ячеек, пересекающих область; точную проверку выполняет вызывающий код
+    */
+    class SpatialIndex
+    {
+        public:
+
+            // bounds — область, в которой лежат объекты; item_count — ожидаемое число объектов для выбора размера сетки
+            SpatialIndex(const Rect& bounds, size_t item_count);
+
+            void Insert(const Rect& box, uint32_t id);
+            // Длинный наклонный отрезок задевает лишь малую часть ячеек своего ограничивающего прямоугольника
+            void InsertSegment(svg::Point from, svg::Point to, uint32_t id);
+            // Возвращает отсортированные без повторов номера объектов из ячеек, пересекающих область
+            std::vector<uint32_t> Query(const Rect& area) const;
+
+        private:
+
+            // Номер столбца или строки сетки для координаты; координаты вне области прижимаются к краю
+            size_t CellIndex(double value, double min, double cell_size, size_t count) const;
+
+            // Наибольшее число ячеек по каждой из осей
+            static constexpr size_t MAX_CELLS_PER_AXIS = 256;
+
+            Rect bounds_;
+            size_t columns_ = 1;
+            size_t rows_ = 1;
+            double cell_width_ = 1.0;
+            double cell_height_ = 1.0;
+            std::vector<std::vector<uint32_t>> cells_;
+    };
+
+    /*
+    * Раскладка надписей без наложений: надпись принимается, если её прямоугольник не пересекается
+    * ни с одной из принятых ранее. Принятые прямоугольники хранятся в равномерной сетке,
+    * поэтому проверка в среднем затрагивает лишь несколько соседних надписей
+    */
+    class LabelPlacer
+    {
+        public:
+
+            // bounds — область изображения; label_count — ожидаемое число надписей
+            LabelPlacer(const Rect& bounds, size_t label_count);
+
+            // Принимает надпись и возвращает true, если она не пересекается с уже принятыми
+            bool TryPlace(const Rect& box);
+
+        private:
+
+            SpatialIndex index_;
+            std::vector<Rect> placed_;
+    };
+} // end namespace renderer
@@ -1,4 +1,8 @@
 #include "svg.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <iterator>
 
 using namespace std::literals;
 
@@ -6,33 +10,116 @@ namespace svg
 {
     namespace
     {
-        void RenderColor(std::ostream& out, std::monostate)
+        void RenderColor(OutputBuffer& out, std::monostate)
         {
-            out << "none"s;
+            out << "none"sv;
         }
 
-        void RenderColor(std::ostream& out, const std::string& value)
+        void RenderColor(OutputBuffer& out, const std::string& value)
         {
-            out << value;
+            out << std::string_view(value);
         }
 
-        void RenderColor(std::ostream& out, Rgb rgb)
+        void RenderColor(OutputBuffer& out, Rgb rgb)
         {
             out << "rgb("sv << static_cast<int>(rgb.red)
                 << ',' << static_cast<int>(rgb.green)
                 << ',' << static_cast<int>(rgb.blue) << ')';
         }
 
-        void RenderColor(std::ostream& out, Rgba rgba)
+        void RenderColor(OutputBuffer& out, Rgba rgba)
         {
             out << "rgba("sv << static_cast<int>(rgba.red)
                 << ',' << static_cast<int>(rgba.green)
                 << ',' << static_cast<int>(rgba.blue)
                 << ',' << rgba.opacity << ')';
         }
+
+        // Выводит число value / 10^digits без незначащих нулей в дробной части
+        void RenderScaled(OutputBuffer& out, int64_t value, int digits, int64_t scale)
+        {
+            if (value < 0)
+            {
+                out.put('-');
+                value = -value;
+            }
+
+            out << value / scale;
+            int64_t fraction = value % scale;
+
+            if (fraction == 0)
+            {
+                return;
+            }
+
+            char chars[16];
+            int length = digits;
+
+            for (int i = digits - 1; i >= 0; --i)
+            {
+                chars[i] = static_cast<char>('0' + fraction % 10);
+                fraction /= 10;
+            }
+
+            while (chars[length - 1] == '0')
+            {
+                --length;
+            }
+
+            out.put('.');
+            out << std::string_view(chars, length);
+        }
+
+        // Выводит значение в std::ostream через OutputBuffer
+        template <typename T>
+        std::ostream& PrintToStream(std::ostream& out, const T& value)
+        {
+            std::string bytes;
+            OutputBuffer buffer(bytes);
+            buffer << value;
+
+            return out << bytes;
+        }
     }  // end namespace
 
-    std::ostream& operator<<(std::ostream& out, const Color& color)
+    OutputBuffer& OutputBuffer::operator<<(int value)
+    {
+        char chars[16];
+        const auto result = std::to_chars(std::begin(chars), std::end(chars), value);
+        out_.append(chars, result.ptr);
+
+        return *this;
+    }
+
+    OutputBuffer& OutputBuffer::operator<<(uint32_t value)
+    {
+        char chars[16];
+        const auto result = std::to_chars(std::begin(chars), std::end(chars), value);
+        out_.append(chars, result.ptr);
+
+        return *this;
+    }
+
+    OutputBuffer& OutputBuffer::operator<<(int64_t value)
+    {
+        char chars[24];
+        const auto result = std::to_chars(std::begin(chars), std::end(chars), value);
+        out_.append(chars, result.ptr);
+
+        return *this;
+    }
+
+    OutputBuffer& OutputBuffer::operator<<(double value)
+    {
+        // Общий формат с 6 значащими цифрами совпадает с выводом double в std::ostream по умолчанию
+        char chars[32];
+        const auto result = std::to_chars(std::begin(chars), std::end(chars), value, std::chars_format::general, 6);
+        out_.append(chars, result.ptr);
+
+        return *this;
+    }
+
+    OutputBuffer& operator<<(OutputBuffer& out, const Color& color)
     {
         std::visit([&out](const auto& value)
             {
@@ -41,7 +128,22 @@ namespace svg
         return out;
     }
 
+    std::ostream& operator<<(std::ostream& out, const Color& color)
+    {
+        return PrintToStream(out, color);
+    }
+
     std::ostream& operator<<(std::ostream& out, StrokeLineCap value)
+    {
+        return PrintToStream(out, value);
+    }
+
+    std::ostream& operator<<(std::ostream& out, StrokeLineJoin value)
+    {
+        return PrintToStream(out, value);
+    }
+
+    OutputBuffer& operator<<(OutputBuffer& out, StrokeLineCap value)
     {
         std::string_view sv;
 
@@ -63,7 +165,7 @@ namespace svg
         return out << sv;
     }
 
-    std::ostream& operator<<(std::ostream& out, StrokeLineJoin value)
+    OutputBuffer& operator<<(OutputBuffer& out, StrokeLineJoin value)
     {
         std::string_view sv;
 
@@ -99,7 +201,7 @@ namespace svg
         // Делегируем вывод тэга своим подклассам
         RenderObject(context);
 
-        context.out << std::endl;
+        context.out.put('\n');
     }
 
     // Circle
@@ -117,6 +219,11 @@ namespace svg
     }
 
     void Circle::RenderObject(const RenderContext& context) const
+    {
+        RenderDirect(context);
+    }
+
+    void Circle::RenderDirect(const RenderContext& context) const
     {
         auto& out = context.out;
         out << "<circle cx=\""sv << center_.x << "\" cy=\""sv << center_.y << "\" "sv;
@@ -133,9 +240,33 @@ namespace svg
         return *this;
     }
 
+    Polyline& Polyline::ReservePoints(size_t count)
+    {
+        points_.reserve(count);
+        return *this;
+    }
+
+    Polyline& Polyline::SetPathEncoding(int digits)
+    {
+        path_digits_ = std::clamp(digits, 0, 9);
+        return *this;
+    }
+
     void Polyline::RenderObject(const RenderContext& context) const
+    {
+        RenderDirect(context);
+    }
+
+    void Polyline::RenderDirect(const RenderContext& context) const
     {
         auto& out = context.out;
+
+        if (path_digits_)
+        {
+            RenderPath(out);
+            return;
+        }
+
         out << "<polyline points=\""sv;
         bool first = true;
 
@@ -158,6 +289,50 @@ namespace svg
         out << "/>"sv;
     }
 
+    void Polyline::RenderPath(OutputBuffer& out) const
+    {
+        const int digits = *path_digits_;
+        int64_t scale = 1;
+
+        for (int i = 0; i < digits; ++i)
+        {
+            scale *= 10;
+        }
+
+        out << "<path d=\""sv;
+        int64_t previous_x = 0;
+        int64_t previous_y = 0;
+
+        for (size_t i = 0; i < points_.size(); ++i)
+        {
+            // Смещения считаются между уже округлёнными координатами
+            const int64_t x = std::llround(points_[i].x * scale);
+            const int64_t y = std::llround(points_[i].y * scale);
+
+            if (i == 0)
+            {
+                out.put('M');
+                RenderScaled(out, x, digits, scale);
+                out.put(',');
+                RenderScaled(out, y, digits, scale);
+            }
+
+            else
+            {
+                out.put(i == 1 ? 'l' : ' ');
+                RenderScaled(out, x - previous_x, digits, scale);
+                out.put(',');
+                RenderScaled(out, y - previous_y, digits, scale);
+            }
+
+            previous_x = x;
+            previous_y = y;
+        }
+        out << "\" "sv;
+        RenderAttrs(out);
+        out << "/>"sv;
+    }
+
     // Text
 
     Text& Text::SetPosition(Point pos)
@@ -172,7 +347,7 @@ namespace svg
         return *this;
     }
 
-    Text& Text::SetFontSize(uint32_t size)
+    Text& Text::SetFontSize(std::optional<uint32_t> size)
     {
         font_size_ = size;
         return *this;
@@ -197,6 +372,11 @@ namespace svg
     }
 
     void Text::RenderObject(const RenderContext& context) const
+    {
+        RenderDirect(context);
+    }
+
+    void Text::RenderDirect(const RenderContext& context) const
     {
         auto& out = context.out;
         out << "<text "sv;
@@ -206,7 +386,7 @@ namespace svg
         RenderAttr(out, " y"sv, position_.y);
         RenderAttr(out, " dx"sv, offset_.x);
         RenderAttr(out, " dy"sv, offset_.y);
-        RenderAttr(out, " font-size"sv, font_size_);
+        detail::RenderOptionalAttr(out, " font-size"sv, font_size_);
 
         if (!font_family_.empty())
         {
@@ -223,29 +403,104 @@ namespace svg
         out << "</text>"sv;
     }
 
+    // StyleSheet
+
+    StyleSheet& StyleSheet::SetCss(std::string css)
+    {
+        css_ = std::move(css);
+        return *this;
+    }
+
+    void StyleSheet::RenderObject(const RenderContext& context) const
+    {
+        auto& out = context.out;
+        out << "<style>"sv;
+        detail::HtmlEncodeString(out, css_);
+        out << "</style>"sv;
+    }
+
     // Document
 
+    void Document::Add(Circle circle)
+    {
+        objects_.emplace_back(std::move(circle));
+    }
+
+    void Document::Add(Polyline polyline)
+    {
+        objects_.emplace_back(std::move(polyline));
+    }
+
+    void Document::Add(Text text)
+    {
+        objects_.emplace_back(std::move(text));
+    }
+
     void Document::AddPtr(std::unique_ptr<Object>&& obj)
     {
-        objects_.push_back(std::move(obj));
+        objects_.emplace_back(std::move(obj));
+    }
+
+    void Document::Reserve(size_t count)
+    {
+        objects_.reserve(count);
     }
 
     void Document::Render(std::ostream& out) const
     {
-        out << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>"sv << std::endl;
-        out << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">"sv << std::endl;
-        RenderContext ctx{ out, 2, 2 };
+        // Документ собирается в строке и выводится одним вызовом write
+        std::string bytes;
+        Render(bytes);
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    }
+
+    void Document::Render(std::string& out) const
+    {
+        RenderHeader(out);
+        RenderObjects(out);
+        RenderFooter(out);
+    }
+
+    void Document::RenderObjects(std::string& out) const
+    {
+        OutputBuffer buffer(out);
+        RenderContext ctx{ buffer, 2, 2 };
 
         for (const auto& obj : objects_)
         {
-            obj->Render(ctx);
+            std::visit([&ctx](const auto& value)
+                {
+                    using Type = std::decay_t<decltype(value)>;
+
+                    if constexpr (std::is_same_v<Type, std::unique_ptr<Object>>)
+                    {
+                        value->Render(ctx);
+                    }
+
+                    else
+                    {
+                        ctx.RenderIndent();
+                        value.RenderDirect(ctx);
+                        ctx.out.put('\n');
+                    }
+                }, obj);
         }
-        out << "</svg>"sv;
+    }
+
+    void Document::RenderHeader(std::string& out)
+    {
+        out += "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"sv;
+        out += "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">\n"sv;
+    }
+
+    void Document::RenderFooter(std::string& out)
+    {
+        out += "</svg>"sv;
     }
 
     namespace detail
     {
-        void HtmlEncodeString(std::ostream& out, std::string_view sv)
+        void HtmlEncodeString(OutputBuffer& out, std::string_view sv)
         {
             for (char c : sv)
             {
@@ -13,24 +13,63 @@ using namespace std::literals;
 
 namespace svg
 {
+    /*
+    * Буфер вывода SVG: байты дописываются в растущую строку без участия std::ostream.
+    * Числа форматируются через std::to_chars в том же виде, что и при выводе в std::ostream по умолчанию
+    */
+    class OutputBuffer
+    {
+    public:
+
+        explicit OutputBuffer(std::string& out)
+            : out_(out)
+        {}
+
+        OutputBuffer& operator<<(std::string_view value)
+        {
+            out_ += value;
+            return *this;
+        }
+
+        OutputBuffer& operator<<(char value)
+        {
+            out_.push_back(value);
+            return *this;
+        }
+
+        OutputBuffer& operator<<(int value);
+        OutputBuffer& operator<<(uint32_t value);
+        OutputBuffer& operator<<(int64_t value);
+        OutputBuffer& operator<<(double value);
+
+        void put(char value)
+        {
+            out_.push_back(value);
+        }
+
+    private:
+
+        std::string& out_;
+    };
+
     namespace detail
     {
         template <typename T>
-        inline void RenderValue(std::ostream& out, const T& value)
+        inline void RenderValue(OutputBuffer& out, const T& value)
         {
             out << value;
         }
 
-        void HtmlEncodeString(std::ostream& out, std::string_view sv);
+        void HtmlEncodeString(OutputBuffer& out, std::string_view sv);
 
         template <>
-        inline void RenderValue<std::string>(std::ostream& out, const std::string& s)
+        inline void RenderValue<std::string>(OutputBuffer& out, const std::string& s)
         {
             HtmlEncodeString(out, s);
         }
 
         template <typename AttrType>
-        inline void RenderAttr(std::ostream& out, std::string_view name, const AttrType& value)
+        inline void RenderAttr(OutputBuffer& out, std::string_view name, const AttrType& value)
         {
             out << name << "=\""sv;
             RenderValue(out, value);
@@ -38,7 +77,7 @@ namespace svg
         }
 
         template <typename AttrType>
-        inline void RenderOptionalAttr(std::ostream& out, std::string_view name, const std::optional<AttrType>& value)
+        inline void RenderOptionalAttr(OutputBuffer& out, std::string_view name, const std::optional<AttrType>& value)
         {
             if (value)
             {
@@ -93,18 +132,19 @@ namespace svg
     inline const Color NoneColor{};
 
     std::ostream& operator<<(std::ostream& out, const Color& color);
+    OutputBuffer& operator<<(OutputBuffer& out, const Color& color);
 
     /*
     * Вспомогательная структура, хранящая контекст для вывода SVG-документа с отступами.
-    * Хранит ссылку на поток вывода, текущее значение и шаг отступа при выводе элемента
+    * Хранит ссылку на буфер вывода, текущее значение и шаг отступа при выводе элемента
     */
     struct RenderContext
     {
-        RenderContext(std::ostream& out)
+        RenderContext(OutputBuffer& out)
             : out(out)
         {}
 
-        RenderContext(std::ostream& out, int indent_step, int indent = 0)
+        RenderContext(OutputBuffer& out, int indent_step, int indent = 0)
             : out(out)
             , indent_step(indent_step)
             , indent(indent)
@@ -123,7 +163,7 @@ namespace svg
             }
         }
 
-        std::ostream& out;
+        OutputBuffer& out;
         int indent_step = 0;
         int indent = 0;
     };
@@ -154,6 +194,7 @@ namespace svg
     };
 
     std::ostream& operator<<(std::ostream& out, StrokeLineCap value);
+    OutputBuffer& operator<<(OutputBuffer& out, StrokeLineCap value);
 
     enum class StrokeLineJoin
     {
@@ -165,6 +206,7 @@ namespace svg
     };
 
     std::ostream& operator<<(std::ostream& out, StrokeLineJoin value);
+    OutputBuffer& operator<<(OutputBuffer& out, StrokeLineJoin value);
 
     template <typename Owner>
     class PathProps
@@ -201,11 +243,18 @@ namespace svg
             return AsOwner();
         }
 
+        // Задаёт классы CSS (атрибут class), через которые элемент получает оформление из таблицы стилей
+        Owner& SetClass(std::string class_name)
+        {
+            class_name_ = std::move(class_name);
+            return AsOwner();
+        }
+
     protected:
 
         ~PathProps() = default;
 
-        void RenderAttrs(std::ostream& out) const
+        void RenderAttrs(OutputBuffer& out) const
         {
             using detail::RenderOptionalAttr;
             using namespace std::literals;
@@ -214,6 +263,12 @@ namespace svg
             RenderOptionalAttr(out, " stroke-width"sv, stroke_width_);
             RenderOptionalAttr(out, " stroke-linecap"sv, stroke_line_cap_);
             RenderOptionalAttr(out, " stroke-linejoin"sv, stroke_line_join_);
+
+            if (class_name_)
+            {
+                const bool has_attrs = fill_color_ || stroke_color_ || stroke_width_ || stroke_line_cap_ || stroke_line_join_;
+                detail::RenderAttr(out, has_attrs ? " class"sv : "class"sv, *class_name_);
+            }
         }
 
     private:
@@ -230,6 +285,7 @@ namespace svg
         std::optional<double> stroke_width_;
         std::optional<StrokeLineCap> stroke_line_cap_;
         std::optional<StrokeLineJoin> stroke_line_join_;
+        std::optional<std::string> class_name_;
     };
 
     /*
@@ -238,13 +294,16 @@ namespace svg
     * Унаследовавшись от PathProps<Circle>, мы "сообщаем" родителю,
     * что владельцем свойств является класс Circle
     */
-    class Circle : public Object, public PathProps<Circle>
+    class Circle final : public Object, public PathProps<Circle>
     {
     public:
 
         Circle& SetCenter(Point center);
         Circle& SetRadius(double radius);
 
+        // Выводит тэг без виртуального вызова, когда тип объекта известен
+        void RenderDirect(const RenderContext& context) const;
+
     private:
 
         void RenderObject(const RenderContext& context) const override;
@@ -257,23 +316,35 @@ namespace svg
     * Класс Polyline моделирует элемент <polyline> для отображения ломаных линий
     * https://developer.mozilla.org/en-US/docs/Web/SVG/Element/polyline
     */
-    class Polyline : public Object, public PathProps<Polyline>
+    class Polyline final : public Object, public PathProps<Polyline>
     {
     public:
         // Добавляет очередную вершину к ломаной линии
         Polyline& AddPoint(Point point);
+        // Резервирует память под заданное количество вершин
+        Polyline& ReservePoints(size_t count);
+        /*
+        * Выводить ломаную элементом <path>: первая вершина задаётся абсолютно, остальные — смещением от предыдущей.
+        * Координаты округляются до digits знаков после запятой (от 0 до 9); округление не накапливается вдоль ломаной
+        */
+        Polyline& SetPathEncoding(int digits);
+
+        void RenderDirect(const RenderContext& context) const;
 
     private:
 
         void RenderObject(const RenderContext& context) const override;
+        void RenderPath(OutputBuffer& out) const;
+
         std::vector<Point> points_;
+        std::optional<int> path_digits_;
     };
 
     /*
     * Класс Text моделирует элемент <text> для отображения текста
     * https://developer.mozilla.org/en-US/docs/Web/SVG/Element/text
     */
-    class Text : public Object, public PathProps<Text>
+    class Text final : public Object, public PathProps<Text>
     {
     public:
         // Задаёт координаты опорной точки (атрибуты x и y)
@@ -282,8 +353,8 @@ namespace svg
         // Задаёт смещение относительно опорной точки (атрибуты dx, dy)
         Text& SetOffset(Point offset);
 
-        // Задаёт размеры шрифта (атрибут font-size)
-        Text& SetFontSize(uint32_t size);
+        // Задаёт размеры шрифта (атрибут font-size); std::nullopt — без атрибута, если размер задан таблицей стилей
+        Text& SetFontSize(std::optional<uint32_t> size);
 
         // Задаёт название шрифта (атрибут font-family)
         Text& SetFontFamily(std::string font_family);
@@ -294,17 +365,35 @@ namespace svg
         // Задаёт текстовое содержимое объекта (отображается внутри тэга text)
         Text& SetData(std::string data);
 
+        void RenderDirect(const RenderContext& context) const;
+
     private:
 
         void RenderObject(const RenderContext& context) const override;
         Point position_;
         Point offset_;
-        uint32_t font_size_ = 1;
+        std::optional<uint32_t> font_size_ = 1u;
         std::string font_family_;
         std::string font_weight_;
         std::string data_;
     };
 
+    /*
+    * Класс StyleSheet моделирует элемент <style> с таблицей стилей CSS
+    * https://developer.mozilla.org/en-US/docs/Web/SVG/Element/style
+    */
+    class StyleSheet final : public Object
+    {
+    public:
+        // Задаёт текст таблицы стилей
+        StyleSheet& SetCss(std::string css);
+
+    private:
+
+        void RenderObject(const RenderContext& context) const override;
+        std::string css_;
+    };
+
 /*
 * Интерфейс, представляющий контейнер SVG объектов.
 */
@@ -345,14 +434,38 @@ namespace svg
     class Document : public ObjectContainer
     {
     public:
+
+        using ObjectContainer::Add;
+
+        // Круги, ломаные и надписи хранятся в документе по значению, подряд в одном массиве:
+        // без отдельного выделения памяти и виртуального вызова на каждый объект
+        void Add(Circle circle);
+        void Add(Polyline polyline);
+        void Add(Text text);
+
         // Добавляет в svg-документ объект-наследник svg::Object
         void AddPtr(std::unique_ptr<Object>&& obj) override;
 
+        // Резервирует место под заданное количество объектов
+        void Reserve(size_t count);
+
         // Выводит в ostream svg-представление документа
         void Render(std::ostream& out) const;
+        // Дописывает svg-представление документа в строку
+        void Render(std::string& out) const;
+        // Дописывает в строку только элементы документа, без заголовка и корневого тэга.
+        // Так документ можно собрать из частей, отрисованных по отдельности
+        void RenderObjects(std::string& out) const;
+
+        // Заголовок и открывающий тэг <svg>, с которых начинается документ
+        static void RenderHeader(std::string& out);
+        // Закрывающий тэг </svg>
+        static void RenderFooter(std::string& out);
 
     private:
 
-        std::vector<std::unique_ptr<Object>> objects_;
+        using Element = std::variant<Circle, Polyline, Text, std::unique_ptr<Object>>;
+
+        std::vector<Element> objects_;
     };
 }  // end namespace svg
\ No newline at end of file
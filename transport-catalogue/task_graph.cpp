@@ -0,0 +1,196 @@
+#include "task_graph.h"
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+#include <utility>
+
+using namespace std::literals;
+
+namespace startup
+{
+    namespace
+    {
+        // Задача, выполняемая в этом потоке
+        struct CurrentTask
+        {
+            const TaskGraph* graph = nullptr;
+            TaskGraph::TaskId id = 0;
+        };
+
+        thread_local CurrentTask current_task;
+    }  // end namespace
+
+    TaskGraph::TaskGraph()
+        : origin_(Clock::now())
+        , start_(started_.get_future().share())
+    {}
+
+    TaskGraph::~TaskGraph()
+    {
+        if (!is_started_)
+        {
+            started_.set_exception(std::make_exception_ptr(std::logic_error("startup task graph was not started"s)));
+        }
+
+        for (const Task& task : tasks_)
+        {
+            if (task.done.valid())
+            {
+                task.done.wait();
+            }
+        }
+    }
+
+    TaskGraph::TaskId TaskGraph::Add(std::string name, std::function<void()> action, const std::vector<TaskId>& dependencies)
+    {
+        std::vector<std::shared_future<void>> waits;
+        waits.reserve(dependencies.size());
+
+        for (TaskId dependency : dependencies)
+        {
+            waits.push_back(tasks_.at(dependency).done);
+        }
+
+        const TaskId id = tasks_.size();
+        Task& task = tasks_.emplace_back();
+        task.name = std::move(name);
+        task.dependencies = dependencies;
+
+        task.done = std::async(std::launch::async, [this, id, &task, start = start_, waits = std::move(waits), action = std::move(action)]()
+        {
+            start.get();
+
+            // Ошибка зависимости пробрасывается дальше, и задача не выполняется
+            for (const std::shared_future<void>& wait : waits)
+            {
+                wait.get();
+            }
+
+            task.start = Clock::now();
+            current_task = { this, id };
+
+            try
+            {
+                action();
+            }
+            catch (...)
+            {
+                current_task = {};
+                task.finish = Clock::now();
+                throw;
+            }
+
+            current_task = {};
+            task.finish = Clock::now();
+        }).share();
+
+        return id;
+    }
+
+    void TaskGraph::Start()
+    {
+        if (!is_started_)
+        {
+            is_started_ = true;
+            started_.set_value();
+        }
+    }
+
+    void TaskGraph::Await(TaskId dependency) const
+    {
+        if (current_task.graph != this || current_task.id == dependency)
+        {
+            return;
+        }
+
+        const std::shared_future<void>& done = tasks_.at(dependency).done;
+
+        if (done.wait_for(0s) == std::future_status::ready)
+        {
+            return;
+        }
+
+        done.wait();
+        tasks_[current_task.id].waits.push_back(dependency);
+    }
+
+    void TaskGraph::Wait()
+    {
+        Start();
+
+        for (const Task& task : tasks_)
+        {
+            task.done.wait();
+        }
+
+        for (const Task& task : tasks_)
+        {
+            task.done.get();
+        }
+    }
+
+    void TaskGraph::Report(std::ostream& output) const
+    {
+        if (tasks_.empty())
+        {
+            return;
+        }
+
+        output << std::fixed << std::setprecision(1);
+        output << "startup tasks:"sv << '\n';
+
+        for (const Task& task : tasks_)
+        {
+            output << "    "sv << task.name << ": "sv << ToMilliseconds(task.start) << " - "sv << ToMilliseconds(task.finish) << " ms"sv;
+
+            for (size_t i = 0; i < task.waits.size(); ++i)
+            {
+                output << (i == 0 ? ", waited for "sv : ", "sv) << tasks_[task.waits[i]].name;
+            }
+
+            output << '\n';
+        }
+
+        const auto finished_earlier = [this](TaskId lhs, TaskId rhs)
+        {
+            return tasks_[lhs].finish < tasks_[rhs].finish;
+        };
+
+        std::vector<TaskId> all(tasks_.size());
+
+        for (TaskId id = 0; id < all.size(); ++id)
+        {
+            all[id] = id;
+        }
+
+        std::vector<TaskId> path = { *std::max_element(all.begin(), all.end(), finished_earlier) };
+
+        for (;;)
+        {
+            // Задача не могла закончиться раньше самой поздней из задач, которых она ждала явно или через Await
+            std::vector<TaskId> predecessors = tasks_[path.back()].dependencies;
+            predecessors.insert(predecessors.end(), tasks_[path.back()].waits.begin(), tasks_[path.back()].waits.end());
+
+            if (predecessors.empty())
+            {
+                break;
+            }
+
+            path.push_back(*std::max_element(predecessors.begin(), predecessors.end(), finished_earlier));
+        }
+
+        output << "critical path:"sv;
+
+        for (auto it = path.rbegin(); it != path.rend(); ++it)
+        {
+            output << (it == path.rbegin() ? " "sv : " -> "sv) << tasks_[*it].name;
+        }
+
+        output << " ("sv << ToMilliseconds(tasks_[path.front()].finish) << " ms)"sv << std::endl;
+    }
+
+    double TaskGraph::ToMilliseconds(Clock::time_point time) const
+    {
+        return std::chrono::duration<double, std::milli>(time - origin_).count();
+    }
+} // end namespace startup
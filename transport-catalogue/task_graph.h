@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <future>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+* Граф задач запуска. Задача начинается, как только завершены все её зависимости, поэтому независимые этапы
+* (например, построение маршрутизатора и отрисовка карты) выполняются параллельно.
+* Каждая задача выполняется в своём потоке и ждёт зависимости через std::shared_future.
+* Кроме объявленных зависимостей, задача может дождаться другой задачи по ходу работы через Await
+* (например, запросы — построения маршрутизатора); такие ожидания тоже попадают в критический путь.
+* Для отчёта сохраняются моменты начала и окончания задач
+*/
+namespace startup
+{
+    class TaskGraph
+    {
+        public:
+
+            using TaskId = size_t;
+
+            TaskGraph();
+            // Дожидается незавершённых задач: они пишут свои времена в элементы графа. Незапущенные задачи не выполняются
+            ~TaskGraph();
+
+            TaskGraph(const TaskGraph&) = delete;
+            TaskGraph& operator=(const TaskGraph&) = delete;
+
+            // Добавляет задачу; зависимости должны быть добавлены раньше. Все задачи добавляются до Start
+            TaskId Add(std::string name, std::function<void()> action, const std::vector<TaskId>& dependencies = {});
+            // Запускает задачи; до этого они ждут, чтобы между Add и Start можно было подготовить общие данные
+            void Start();
+            /*
+            * Вызывается из выполняемой задачи: дожидается задачи dependency и, если та ещё не завершилась,
+            * запоминает ожидание для критического пути. Вне задач графа и для самой задачи ничего не делает
+            */
+            void Await(TaskId dependency) const;
+            // Запускает задачи, если они ещё не запущены, дожидается всех и пробрасывает исключение первой по порядку добавления задачи, завершившейся ошибкой
+            void Wait();
+            /*
+            * Выводит время каждой задачи и критический путь: цепочку от последней завершившейся задачи назад,
+            * в которой каждая задача ждала самую позднюю из своих зависимостей и задач, дождаться которых пришлось
+            * через Await. Вызывается после Wait
+            */
+            void Report(std::ostream& output) const;
+
+        private:
+
+            using Clock = std::chrono::steady_clock;
+
+            struct Task
+            {
+                std::string name;
+                std::vector<TaskId> dependencies;
+                // Задачи, которых пришлось ждать через Await; пишет только поток самой задачи
+                mutable std::vector<TaskId> waits;
+                std::shared_future<void> done;
+                Clock::time_point start;
+                Clock::time_point finish;
+            };
+
+            double ToMilliseconds(Clock::time_point time) const;
+
+            Clock::time_point origin_;
+            std::promise<void> started_;
+            std::shared_future<void> start_;
+            bool is_started_ = false;
+            // Ссылки на элементы deque не меняются при добавлении новых задач, пока запущенные задачи пишут свои времена
+            std::deque<Task> tasks_;
+    };
+} // end namespace startup
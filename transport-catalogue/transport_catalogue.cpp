@@ -28,14 +28,15 @@ namespace tc
         buses_.push_back(bus);
         busname_to_bus_[buses_.back().number] = &buses_.back();
 
+        // Остановка ищется по названию через индекс, а не перебором всей базы: 
+        // объекты в stops_ изменяемы, константны лишь указатели на них в индексе
         for (const auto& bus_stop : bus.stops) 
         {
-            for (auto& stop : stops_) 
+            const auto it = stopname_to_stop_.find(bus_stop->name);
+
+            if (it != stopname_to_stop_.end()) 
             {
-                if (stop.name == bus_stop->name) 
-                {
-                    stop.buses.insert(bus.number);
-                }
+                const_cast<Stop*>(it->second)->buses.insert(bus.number);
             }
         }
     }
@@ -168,4 +169,9 @@ namespace tc
 
         return bus_stat;
     }
+
+    const TransportCatalogue::HashedDistanceBtwStops& TransportCatalogue::GetAllDistances() const 
+    {
+        return dist_btw_stops;
+    }
 }  // end namespace tc
\ No newline at end of file
@@ -40,10 +40,11 @@ namespace tc
         using StopMap = std::unordered_map<std::string_view, const Stop*>;
         using BusMap = std::unordered_map<std::string_view, const Bus*>;
         using HashedStops = std::unordered_set<const Stop*, Hasher>;
-        using HashedDistanceBtwStops = std::unordered_map<std::pair<const Stop*, const Stop*>, int, Hasher>;
 
         public:
 
+            using HashedDistanceBtwStops = std::unordered_map<std::pair<const Stop*, const Stop*>, int, Hasher>;
+
             // добавление остановки в базу
             void AddStop(tc::Stop stop);
             // поиск остановки по названию
@@ -66,6 +67,8 @@ namespace tc
             std::pair<int, double> GetRouteLength(const tc::Bus* bus) const;
             // Возвращает информацию о маршруте (запрос Bus)
             std::optional<tc::BusStat> GetBusStat(const std::string_view bus_number) const;
+            // Все заданные расстояния между парами остановок
+            const HashedDistanceBtwStops& GetAllDistances() const;
 
         private:
             // База остановок
@@ -1,5 +1,8 @@
 #include "transport_router.h"
 
+#include <string_view>
+#include <unordered_map>
+
 const double TIME = 6.00;
 const int MULTIPLIER = 100;
 
@@ -8,64 +11,223 @@ namespace tc
     void tc::TransportRouter::AddEdgesGraph(const TransportCatalogue& catalogue)
     {
         graph::VertexId vertex_id = 0;
-        std::map<const tc::Stop*, graph::VertexId> stop_to_vertex_id_ = {};
+        stop_to_vertex_id_ = NumberVertices(catalogue);
         
-        for (const auto& [stop_name, stop_ptr] : catalogue.GetAllStops()) 
+        for (const Stop* stop_ptr : vertex_stops_) 
         {
-            stop_to_vertex_id_[stop_ptr] = vertex_id;
             graph_.AddEdge({ stop_ptr->name, 0,vertex_id, ++vertex_id, static_cast<double>(routing_settings_.bus_wait_time_) });
+            edge_spans_.push_back({});
             
             ++vertex_id;
         }
 
         for (auto& [name, bus_ptr] : catalogue.GetAllBuses())
         {
+            AddBusEdges(catalogue, bus_ptr, stop_to_vertex_id_);
+        }
+    } 
+
+    graph::EdgeId TransportRouter::AddBusEdges(const TransportCatalogue& catalogue, const Bus* bus_ptr, const std::map<const tc::Stop*, graph::VertexId>& stop_to_vertex_id_) 
+    {
+        const graph::EdgeId first_edge = graph_.GetEdgeCount();
 
-            for (size_t i = 0; i < bus_ptr->stops.size(); ++i) 
+        for (size_t i = 0; i < bus_ptr->stops.size(); ++i) 
+        {
+            size_t span_count = 1;
+            
+            for (size_t j = i + 1; j < bus_ptr->stops.size(); ++j) 
             {
-                size_t span_count = 1;
+                int A_to_B = 0;
+                int B_to_A = 0;
+
+                for (size_t d = i + 1; d <= j; ++d) 
+                {
+                    // Получаем расстояние от остановки А до остановки В
+                    A_to_B += catalogue.GetDistance(bus_ptr->stops[d - 1], bus_ptr->stops[d]);
+                    // И от В до А, т.к. расстояние от остановки A до остановки B может быть не равно расстоянию от B до A
+                    B_to_A += catalogue.GetDistance(bus_ptr->stops[d], bus_ptr->stops[d - 1]);
+                }
+
+                const Stop* from = bus_ptr->stops[i];
+                const Stop* to = bus_ptr->stops[j];
+
+                // Добавляем ребро "Остановка А - "Остановка B" для каждого маршрута
+                graph_.AddEdge({ bus_ptr->number, span_count,
+                                        stop_to_vertex_id_.at(from) + 1, stop_to_vertex_id_.at(to),
+                                        GetTravelTime(A_to_B)
+                                        });
+                edge_spans_.push_back({ bus_ptr, static_cast<uint32_t>(i), static_cast<uint32_t>(j) });
                 
-                for (size_t j = i + 1; j < bus_ptr->stops.size(); ++j) 
+                // Если маршрут некольцевой - так же добавляем ребро "Остановка B - Остановка A"
+                if (!bus_ptr->is_roundtrip) 
                 {
-                    int A_to_B = 0;
-                    int B_to_A = 0;
-
-                    for (size_t d = i + 1; d <= j; ++d) 
-                    {
-                        // Получаем расстояние от остановки А до остановки В
-                        A_to_B += catalogue.GetDistance(bus_ptr->stops[d - 1], bus_ptr->stops[d]);
-                        // И от В до А, т.к. расстояние от остановки A до остановки B может быть не равно расстоянию от B до A
-                        B_to_A += catalogue.GetDistance(bus_ptr->stops[d], bus_ptr->stops[d - 1]);
-                    }
-
-                    const Stop* from = bus_ptr->stops[i];
-                    const Stop* to = bus_ptr->stops[j];
-
-                    // Добавляем ребро "Остановка А - "Остановка B" для каждого маршрута
-                    graph_.AddEdge({ bus_ptr->number, span_count,
-                                            stop_to_vertex_id_.at(from) + 1, stop_to_vertex_id_.at(to),
-                                            // Разделив расстояние на среднюю скорость движения (скорость / время * 100), 
-                                            // получаем время за которое было преодалено это расстояние
-                                            A_to_B / (routing_settings_.bus_velocity_ / TIME * MULTIPLIER)
+                    graph_.AddEdge({ bus_ptr->number, span_count, 
+                                            stop_to_vertex_id_.at(to) + 1, stop_to_vertex_id_.at(from),
+                                            GetTravelTime(B_to_A)
                                             });
-                    
-                    // Если маршрут некольцевой - так же добавляем ребро "Остановка B - Остановка A"
-                    if (!bus_ptr->is_roundtrip) 
-                    {
-                        graph_.AddEdge({ bus_ptr->number, span_count, 
-                                                stop_to_vertex_id_.at(to) + 1, stop_to_vertex_id_.at(from),
-                                                B_to_A / (routing_settings_.bus_velocity_ / TIME * MULTIPLIER)
-                                                });
-                    }
-                    
-                    ++span_count;
+                    edge_spans_.push_back({ bus_ptr, static_cast<uint32_t>(j), static_cast<uint32_t>(i) });
                 }
+                
+                ++span_count;
             }
         }
-        
-       	router_ = std::make_unique<graph::Router<double>>(graph_);
-        router_->SetVertexId(stop_to_vertex_id_);
-    } 
+
+        return first_edge;
+    }
+
+    double TransportRouter::GetTravelTime(int distance) const 
+    {
+        // Разделив расстояние на среднюю скорость движения (скорость / время * 100), 
+        // получаем время за которое было преодалено это расстояние
+        return distance / (routing_settings_.bus_velocity_ / TIME * MULTIPLIER);
+    }
+
+    TransportRouter::TransportRouter(const TransportRouter& previous, const TransportCatalogue& catalogue) 
+        : routing_settings_(previous.routing_settings_)
+    {
+        stop_to_vertex_id_ = NumberVertices(catalogue);
+        graph::Router<double>::GraphChange change;
+        change.vertex_map.reserve(previous.graph_.GetVertexCount());
+
+        for (const Stop* old_stop : previous.vertex_stops_) 
+        {
+            const Stop* stop = catalogue.GetStop(old_stop->name);
+
+            if (!stop) 
+            {
+                BuildGraph(catalogue);
+                return;
+            }
+
+            change.vertex_map.push_back(stop_to_vertex_id_.at(stop));
+            change.vertex_map.push_back(stop_to_vertex_id_.at(stop) + 1);
+        }
+
+        graph_ = graph::DirectedWeightedGraph<double> (vertex_stops_.size() * 2);
+        change.edge_map.resize(previous.graph_.GetEdgeCount());
+        std::vector<bool> kept_stops(vertex_stops_.size());
+
+        // Ребро ожидания k-й остановки имеет номер k и в прежнем, и в новом графе
+        for (size_t k = 0; k < previous.vertex_stops_.size(); ++k) 
+        {
+            change.edge_map[k] = change.vertex_map[2 * k] / 2;
+            kept_stops[change.vertex_map[2 * k] / 2] = true;
+        }
+
+        for (size_t k = 0; k < vertex_stops_.size(); ++k) 
+        {
+            const graph::VertexId vertex_id = 2 * k;
+            graph_.AddEdge({ vertex_stops_[k]->name, 0, vertex_id, vertex_id + 1, static_cast<double>(routing_settings_.bus_wait_time_) });
+            edge_spans_.push_back({});
+
+            if (!kept_stops[k]) 
+            {
+                change.new_edges.push_back(k);
+            }
+        }
+
+        // Рёбра прежних маршрутов идут подряд после рёбер ожидания
+        std::unordered_map<std::string_view, std::pair<graph::EdgeId, graph::EdgeId>> old_bus_edges;
+
+        for (graph::EdgeId edge_id = previous.vertex_stops_.size(); edge_id < previous.edge_spans_.size(); ++edge_id) 
+        {
+            auto [it, inserted] = old_bus_edges.emplace(previous.edge_spans_[edge_id].bus->number, std::make_pair(edge_id, edge_id + 1));
+
+            if (!inserted) 
+            {
+                it->second.second = edge_id + 1;
+            }
+        }
+
+        for (const auto& [name, bus_ptr] : catalogue.GetAllBuses()) 
+        {
+            const auto old_edges = old_bus_edges.find(name);
+
+            if (old_edges != old_bus_edges.end() && HasSameEdges(previous, old_edges->second.first, old_edges->second.second, catalogue, bus_ptr)) 
+            {
+                for (graph::EdgeId edge_id = old_edges->second.first; edge_id < old_edges->second.second; ++edge_id) 
+                {
+                    graph::Edge<double> edge = previous.graph_.GetEdge(edge_id);
+                    edge.from = change.vertex_map[edge.from];
+                    edge.to = change.vertex_map[edge.to];
+
+                    change.edge_map[edge_id] = graph_.AddEdge(edge);
+                    edge_spans_.push_back({ bus_ptr, previous.edge_spans_[edge_id].first, previous.edge_spans_[edge_id].last });
+                }
+
+                continue;
+            }
+
+            for (graph::EdgeId edge_id = AddBusEdges(catalogue, bus_ptr, stop_to_vertex_id_); edge_id < graph_.GetEdgeCount(); ++edge_id) 
+            {
+                change.new_edges.push_back(edge_id);
+            }
+        }
+
+        // Без прежней таблицы чинить нечего: новая строится целиком при первом запросе маршрута
+        if (const graph::Router<double>* previous_router = previous.router_.load()) 
+        {
+            own_router_ = std::make_unique<graph::Router<double>>(graph_, *previous_router, change);
+            router_ = own_router_.get();
+        }
+    }
+
+    bool TransportRouter::HasSameEdges(const TransportRouter& previous, graph::EdgeId first, graph::EdgeId last, const TransportCatalogue& catalogue, const Bus* bus) const 
+    {
+        const Bus* old_bus = previous.edge_spans_[first].bus;
+
+        if (old_bus->is_roundtrip != bus->is_roundtrip || old_bus->stops.size() != bus->stops.size()) 
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < bus->stops.size(); ++i) 
+        {
+            if (old_bus->stops[i]->name != bus->stops[i]->name) 
+            {
+                return false;
+            }
+        }
+
+        // Рёбра через несколько перегонов — суммы соседних, поэтому достаточно сравнить рёбра в один перегон
+        for (graph::EdgeId edge_id = first; edge_id < last; ++edge_id) 
+        {
+            const EdgeSpan& span = previous.edge_spans_[edge_id];
+
+            if (previous.graph_.GetEdge(edge_id).span_count == 1 
+                && previous.graph_.GetEdge(edge_id).weight != GetTravelTime(catalogue.GetDistance(bus->stops[span.first], bus->stops[span.last]))) 
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    TransportRouter::TransportRouter(const RoutingSettings& routing_settings, const TransportCatalogue& catalogue, graph::DirectedWeightedGraph<double> graph, 
+                                     std::vector<EdgeSpan> edge_spans, const graph::Router<double>::RouteEntry* routes, std::shared_ptr<const void> storage)
+        : graph_(std::move(graph))
+        , routing_settings_(routing_settings)
+        , edge_spans_(std::move(edge_spans))
+    {
+        own_router_ = std::make_unique<graph::Router<double>>(graph_, routes, std::move(storage));
+        router_ = own_router_.get();
+        stop_to_vertex_id_ = NumberVertices(catalogue);
+    }
+
+    std::map<const tc::Stop*, graph::VertexId> TransportRouter::NumberVertices(const TransportCatalogue& catalogue) 
+    {
+        std::map<const tc::Stop*, graph::VertexId> stop_to_vertex_id;
+        vertex_stops_.clear();
+
+        for (const auto& [stop_name, stop_ptr] : catalogue.GetAllStops()) 
+        {
+            stop_to_vertex_id[stop_ptr] = 2 * vertex_stops_.size();
+            vertex_stops_.push_back(stop_ptr);
+        }
+
+        return stop_to_vertex_id;
+    }
 
     void tc::TransportRouter::BuildGraph(const TransportCatalogue& catalogue) 
     {
@@ -75,11 +237,121 @@ namespace tc
 
     const std::optional<graph::Router<double>::RouteInfo> TransportRouter::GetRoute(const tc::Stop* from, const tc::Stop* to) const 
     {
-        return router_->BuildRoute(router_->GetVertexId(from), router_->GetVertexId(to));
+        return GetRouter().BuildRoute(GetVertexId(from), GetVertexId(to));
+    }
+
+    TransportRouter::RoutesFrom TransportRouter::GetRoutesFrom(const tc::Stop* from) const 
+    {
+        return RoutesFrom(*this, GetRouter().GetRouteTree(GetVertexId(from)));
+    }
+
+    std::vector<StopArrival> TransportRouter::GetReachableStops(const tc::Stop* from, double time_limit) const 
+    {
+        std::vector<StopArrival> arrivals;
+
+        // Поездка заканчивается в вершине ожидания 2k остановки: в неё приходят рёбра автобусов
+        for (const auto& [vertex, time] : graph::Router<double>::FindReachable(graph_, GetVertexId(from), time_limit)) 
+        {
+            if (vertex % 2 == 0) 
+            {
+                arrivals.push_back({ GetVertexStop(vertex), time });
+            }
+        }
+
+        return arrivals;
+    }
+
+    void TransportRouter::BuildRouteTable() const 
+    {
+        GetRouter();
+    }
+
+    const graph::Router<double>& TransportRouter::GetRouter() const 
+    {
+        if (const graph::Router<double>* router = router_.load()) 
+        {
+            return *router;
+        }
+
+        std::call_once(router_built_, [this]() 
+        {
+            if (!router_.load()) 
+            {
+                own_router_ = std::make_unique<graph::Router<double>>(graph_);
+                router_ = own_router_.get();
+            }
+        });
+
+        return *router_.load();
+    }
+
+    graph::VertexId TransportRouter::GetVertexId(const Stop* stop) const 
+    {
+        return stop_to_vertex_id_.at(stop);
+    }
+
+    std::optional<double> TransportRouter::RoutesFrom::GetTotalTime(const tc::Stop* to) const 
+    {
+        return tree_.GetWeight(router_.GetVertexId(to));
+    }
+
+    std::optional<graph::Router<double>::RouteInfo> TransportRouter::RoutesFrom::GetRoute(const tc::Stop* to) const 
+    {
+        return tree_.BuildRoute(router_.GetVertexId(to));
     }
 
     const graph::DirectedWeightedGraph<double>& TransportRouter::GetRouteGraph() const 
     {
-        return router_->GetGraph();
+        return graph_;
+    }
+
+    const RoutingSettings& TransportRouter::GetRoutingSettings() const 
+    {
+        return routing_settings_;
+    }
+
+    const graph::Router<double>::RouteEntry* TransportRouter::GetRouteTable() const 
+    {
+        return GetRouter().GetRouteTable();
+    }
+
+    const Stop* TransportRouter::GetVertexStop(graph::VertexId vertex) const 
+    {
+        return vertex_stops_.at(vertex / 2);
+    }
+
+    const EdgeSpan& TransportRouter::GetEdgeSpan(graph::EdgeId edge_id) const 
+    {
+        return edge_spans_.at(edge_id);
+    }
+
+    size_t TransportRouter::GetRepairedRouteCount() const 
+    {
+        const graph::Router<double>* router = router_.load();
+
+        return router ? router->GetRepairedRouteCount() : 0;
+    }
+
+    std::vector<const Stop*> TransportRouter::GetEdgeStops(graph::EdgeId edge_id) const 
+    {
+        const EdgeSpan& span = GetEdgeSpan(edge_id);
+
+        if (!span.bus) 
+        {
+            return { GetVertexStop(graph_.GetEdge(edge_id).from) };
+        }
+
+        const bool forward = span.first < span.last;
+        std::vector<const Stop*> stops;
+        stops.reserve((forward ? span.last - span.first : span.first - span.last) + 1);
+
+        for (uint32_t i = span.first; i != span.last; forward ? ++i : --i) 
+        {
+            stops.push_back(span.bus->stops[i]);
+        }
+
+        stops.push_back(span.bus->stops[span.last]);
+
+        return stops;
     }
 } // end namespace tc
\ No newline at end of file
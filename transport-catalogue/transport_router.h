@@ -3,10 +3,30 @@
 #include "router.h"
 #include "transport_catalogue.h"
 
+#include <atomic>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 namespace tc 
 {
+	// Поездка по ребру графа: автобус bus проезжает остановки bus->stops[first]..bus->stops[last]; 
+	// у обратного хода некольцевого маршрута first > last. У ребра ожидания bus равен nullptr
+	struct EdgeSpan
+	{
+		const Bus* bus = nullptr;
+		uint32_t first = 0;
+		uint32_t last = 0;
+	};
+
+	// Остановка, до которой можно доехать, и время в пути до неё вместе с ожиданиями
+	struct StopArrival
+	{
+		const Stop* stop = nullptr;
+		double time = 0.0;
+	};
+
 	struct RoutingSettings
 	{
 		int bus_wait_time_ = 0;
@@ -16,23 +36,95 @@ namespace tc
 	class TransportRouter 
 	{
 		public:
+
+			// Кратчайшие маршруты из одной остановки: одно дерево путей на все остановки назначения
+			class RoutesFrom
+			{
+				public:
+
+					// Время в пути до остановки to; nullopt, если маршрута нет
+					std::optional<double> GetTotalTime(const Stop* to) const;
+					std::optional<graph::Router<double>::RouteInfo> GetRoute(const Stop* to) const;
+
+				private:
+
+					friend class TransportRouter;
+
+					RoutesFrom(const TransportRouter& router, graph::Router<double>::RouteTree tree)
+						: router_(router)
+						, tree_(tree)
+						{}
+
+					const TransportRouter& router_;
+					graph::Router<double>::RouteTree tree_;
+			};
 		
+			// Строит граф маршрутов. Таблица кратчайших путей между всеми парами вершин (O(V^3) времени и V×V памяти)
+			// строится при первом запросе маршрута или вызове BuildRouteTable
 			TransportRouter(const RoutingSettings& routing_settings, const TransportCatalogue& catalogue) 
 				: routing_settings_ (routing_settings)
 				{
 					BuildGraph(catalogue);
 				}
 
+			// Восстанавливает маршрутизатор из снимка: граф и кратчайшие пути не перестраиваются.
+			// catalogue должен совпадать со справочником, по которому строился граф. Таблица путей routes не копируется,
+			// storage удерживает её память (например, отображение файла снимка)
+			TransportRouter(const RoutingSettings& routing_settings, const TransportCatalogue& catalogue, graph::DirectedWeightedGraph<double> graph, 
+							std::vector<EdgeSpan> edge_spans, const graph::Router<double>::RouteEntry* routes, std::shared_ptr<const void> storage);
+
+			// Маршрутизатор для изменённой копии справочника: рёбра маршрутов, чьи остановки и расстояния между ними не изменились,
+			// копируются из previous. Если у previous уже есть таблица путей, она чинится сразу: заново ищутся только
+			// кратчайшие пути, которые затронуло изменение; иначе таблица строится при первом запросе маршрута.
+			// Остановки previous ищутся в catalogue по названию; если какой-то нет, граф и пути строятся заново.
+			// previous должен быть жив во время построения
+			TransportRouter(const TransportRouter& previous, const TransportCatalogue& catalogue);
+
 			const std::optional<graph::Router<double>::RouteInfo> GetRoute(const tc::Stop* stop_from, const tc::Stop* stop_to) const;
+			RoutesFrom GetRoutesFrom(const tc::Stop* stop_from) const;
+			// Остановки, до которых из stop_from можно доехать не дольше time_limit минут, в порядке времени в пути.
+			// Ищет только по графу и не строит таблицу путей
+			std::vector<StopArrival> GetReachableStops(const tc::Stop* stop_from, double time_limit) const;
+			// Строит таблицу путей заранее, чтобы её не ждал первый запрос маршрута; допускает одновременные вызовы
+			void BuildRouteTable() const;
 			const graph::DirectedWeightedGraph<double>& GetRouteGraph() const;
+			const RoutingSettings& GetRoutingSettings() const;
+			// Кратчайшие пути между всеми парами вершин графа: таблица V×V, где V — число вершин графа
+			const graph::Router<double>::RouteEntry* GetRouteTable() const;
+			// Остановка, которой соответствует вершина графа
+			const Stop* GetVertexStop(graph::VertexId vertex) const;
+			const EdgeSpan& GetEdgeSpan(graph::EdgeId edge_id) const;
+			// Число путей, найденных заново при построении по прежнему маршрутизатору; 0, если таблица не чинилась
+			size_t GetRepairedRouteCount() const;
+			// Остановки ребра по порядку проезда: от посадки до высадки включительно; у ребра ожидания — одна остановка
+			std::vector<const Stop*> GetEdgeStops(graph::EdgeId edge_id) const;
 
 		private:
 
 			void AddEdgesGraph(const TransportCatalogue& catalogue);
+			// Добавляет рёбра поездок автобуса bus и возвращает номер первого из них
+			graph::EdgeId AddBusEdges(const TransportCatalogue& catalogue, const Bus* bus, const std::map<const tc::Stop*, graph::VertexId>& stop_to_vertex_id);
+			// Можно ли взять рёбра bus из previous: остановки и расстояния между соседними остановками те же
+			bool HasSameEdges(const TransportRouter& previous, graph::EdgeId first, graph::EdgeId last, const TransportCatalogue& catalogue, const Bus* bus) const;
+			// Время в пути на расстояние distance
+			double GetTravelTime(int distance) const;
 			void BuildGraph(const TransportCatalogue& catalogue);
+			// Нумерует вершины графа: остановке с k-м по алфавиту названием принадлежат вершины 2k и 2k + 1
+			std::map<const tc::Stop*, graph::VertexId> NumberVertices(const TransportCatalogue& catalogue);
+			// Маршрутизатор с таблицей путей; строит её при первом обращении
+			const graph::Router<double>& GetRouter() const;
+			graph::VertexId GetVertexId(const Stop* stop) const;
 
 			graph::DirectedWeightedGraph<double> graph_;
-			std::unique_ptr<graph::Router<double>> router_;
+			std::map<const tc::Stop*, graph::VertexId> stop_to_vertex_id_;
+			// Таблица путей, восстановленная или починенная при построении либо построенная при первом обращении
+			mutable std::once_flag router_built_;
+			mutable std::unique_ptr<graph::Router<double>> own_router_;
+			mutable std::atomic<const graph::Router<double>*> router_ = nullptr;
 			RoutingSettings routing_settings_;
+			// Остановки по номеру вершины ожидания: вершины 2k и 2k + 1 принадлежат остановке vertex_stops_[k]
+			std::vector<const Stop*> vertex_stops_;
+			// Поездки по номерам рёбер графа
+			std::vector<EdgeSpan> edge_spans_;
 	};
 } // end namespace tc
\ No newline at end of file